@@ -0,0 +1,590 @@
+#include "bmfont.hpp"
+#include "emoji-search.hpp"
+#include "emojis.hpp"
+#include "scroll-physics.hpp"
+#include "text-layout.hpp"
+#include "text.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <tuple>
+#include <unordered_set>
+#include <vector>
+
+// Headless benchmark of the comment text pipeline:
+// placeholder replacement -> UTF-8 decoding -> emoji parsing -> layout (tokenize, shape, line break, align).
+// Node creation is not covered, the layout delegate below only reports sizes.
+// Also times the emoji picker search (per query) and the scroll physics (per frame).
+// Checks the scroll physics (fling, rubber band, glide) and that measuring agrees with the layout,
+// and exits with 1 if any check fails.
+
+using Clock = std::chrono::steady_clock;
+
+static constexpr size_t MaxCommentLength = 190; // comment length limit in GD
+static constexpr auto MinStageTime = std::chrono::milliseconds(250);
+
+/// @brief Small deterministic generator, so that every run uses the same corpus.
+struct Random {
+    uint64_t state = 0x9e3779b97f4a7c15ull;
+
+    uint32_t next() {
+        state ^= state << 13;
+        state ^= state >> 7;
+        state ^= state << 17;
+        return static_cast<uint32_t>(state);
+    }
+
+    size_t range(size_t max) { return next() % max; }
+};
+
+/// @brief Generate a font shaped like chatFont.fnt (printable ASCII, a few kerning pairs).
+static std::string makeSyntheticFont() {
+    std::string fnt =
+        "info face=\"Bench\" size=32 bold=0 italic=0 charset=\"\" unicode=1 stretchH=100 smooth=1 aa=1 padding=0,0,0,0 spacing=1,1\n"
+        "common lineHeight=32 base=26 scaleW=512 scaleH=512 pages=1 packed=0\n"
+        "page id=0 file=\"bench.png\"\n"
+        "chars count=95\n";
+
+    char line[256];
+    for (int c = 32; c < 127; ++c) {
+        int width = c == ' ' ? 0 : 10 + c % 9;
+        std::snprintf(
+            line, sizeof(line),
+            "char id=%d x=%d y=%d width=%d height=26 xoffset=%d yoffset=3 xadvance=%d page=0 chnl=15\n",
+            c, (c % 16) * 32, (c / 16) * 32, width, c % 3 - 1, width + 2
+        );
+        fnt += line;
+    }
+
+    constexpr const char* pairs[] = { "AV", "AW", "AY", "LT", "To", "Te", "Vo", "Yo", "av", "ty" };
+    std::snprintf(line, sizeof(line), "kernings count=%zu\n", std::size(pairs));
+    fnt += line;
+    for (auto pair : pairs) {
+        std::snprintf(line, sizeof(line), "kerning first=%d second=%d amount=-2\n", pair[0], pair[1]);
+        fnt += line;
+    }
+
+    return fnt;
+}
+
+/// @brief Generate a fallback font covering a range of codepoints, with its own line height.
+static std::string makeFallbackFont(int first, int count, int lineHeight) {
+    char line[256];
+    std::snprintf(line, sizeof(line),
+        "info face=\"Fallback\" size=%d bold=0 italic=0 charset=\"\" unicode=1 stretchH=100 smooth=1 aa=1 padding=0,0,0,0 spacing=1,1\n"
+        "common lineHeight=%d base=%d scaleW=2048 scaleH=2048 pages=1 packed=0\n"
+        "page id=0 file=\"fallback.png\"\n"
+        "chars count=%d\n",
+        lineHeight, lineHeight, lineHeight - 6, count
+    );
+    std::string fnt = line;
+
+    for (int c = first; c < first + count; ++c) {
+        int width = 14 + c % 11;
+        std::snprintf(
+            line, sizeof(line),
+            "char id=%d x=%d y=%d width=%d height=%d xoffset=0 yoffset=2 xadvance=%d page=0 chnl=15\n",
+            c, (c % 64) * 32, ((c - first) / 64 % 64) * 32, width, lineHeight - 4, width + 2
+        );
+        fnt += line;
+    }
+    return fnt;
+}
+
+struct Corpus {
+    const char* name;
+    std::vector<std::string> comments;
+    size_t bytes = 0;
+};
+
+/// @brief Build a comment from random tokens, up to the given length.
+template <class F>
+static std::string makeComment(Random& random, size_t length, F&& nextToken) {
+    std::string comment;
+    while (true) {
+        auto token = nextToken(random);
+        if (comment.size() + token.size() + 1 > length) break;
+        if (!comment.empty()) comment += ' ';
+        comment += token;
+    }
+    return comment;
+}
+
+static std::vector<Corpus> makeCorpora() {
+    constexpr std::string_view words[] = {
+        "this", "level", "is", "so", "good", "the", "deco", "in", "part", "two", "was", "insane",
+        "GG", "verified", "finally", "beat", "it", "after", "3000", "attempts", "wave", "sync",
+        "LOL", "who", "else", "is", "here", "from", "Youtube?", "robtop", "pls", "update", "2.3"
+    };
+    constexpr std::string_view sequences[] = {
+        "\xF0\x9F\x91\xA8\xE2\x80\x8D\xF0\x9F\x91\xA9\xE2\x80\x8D\xF0\x9F\x91\xA7", // family (ZWJ)
+        "\xF0\x9F\x8F\xB3\xEF\xB8\x8F\xE2\x80\x8D\xF0\x9F\x8C\x88",                 // rainbow flag (ZWJ)
+        "\xF0\x9F\x91\x8D\xF0\x9F\x8F\xBD",                                         // thumbs up (skin tone)
+        "\xF0\x9F\x87\xBA\xF0\x9F\x87\xA6",                                         // flag UA
+        "\xF0\x9F\x87\xAF\xF0\x9F\x87\xB5",                                         // flag JP
+        "\x31\xEF\xB8\x8F\xE2\x83\xA3",                                             // keycap 1
+        "\xE2\xAD\x90",                                                             // star
+    };
+
+    auto word = [&](Random& random) { return std::string(words[random.range(std::size(words))]); };
+    auto placeholder = [&](Random& random) {
+        return std::string(EmojiReplacements[random.range(EmojiReplacements.size())].name);
+    };
+    auto sequence = [&](Random& random) { return std::string(sequences[random.range(std::size(sequences))]); };
+
+    std::vector<Corpus> corpora = {
+        { "ascii", {} }, { "emoji-heavy", {} }, { "zwj-flags", {} }, { "max-length", {} }
+    };
+
+    Random random;
+    for (size_t i = 0; i < 256; ++i) {
+        auto length = 20 + random.range(MaxCommentLength - 20);
+        corpora[0].comments.push_back(makeComment(random, length, word));
+        corpora[1].comments.push_back(makeComment(random, length, [&](Random& r) {
+            return r.range(3) == 0 ? word(r) : placeholder(r);
+        }));
+        corpora[2].comments.push_back(makeComment(random, length, [&](Random& r) {
+            return r.range(2) == 0 ? word(r) : sequence(r);
+        }));
+        corpora[3].comments.push_back(makeComment(random, MaxCommentLength, [&](Random& r) {
+            switch (r.range(3)) {
+                case 0: return word(r);
+                case 1: return placeholder(r);
+                default: return sequence(r);
+            }
+        }));
+    }
+
+    for (auto& corpus : corpora) {
+        for (auto& comment : corpus.comments) {
+            corpus.bytes += comment.size();
+        }
+    }
+
+    return corpora;
+}
+
+/// @brief Reports fixed sizes for emojis, like the label does after scaling them to the font height.
+class BenchDelegate final : public LayoutDelegate {
+public:
+    BenchDelegate() {
+        for (auto& entry : AnimatedEmojis) {
+            m_animated.insert(entry.sequence);
+        }
+    }
+
+    bool measureEmoji(EmojiFrame const&, float commonHeight, LayoutMetrics& out) override {
+        out = { commonHeight, 1.f, nullptr };
+        return true;
+    }
+
+    bool measureCustom(
+        std::u32string_view sequence, std::u32string_view, uint32_t&,
+        float commonHeight, LayoutMetrics& out
+    ) override {
+        if (!m_animated.contains(sequence)) return false;
+        out = { commonHeight, 1.f, nullptr };
+        return true;
+    }
+
+private:
+    std::unordered_set<std::u32string_view> m_animated;
+};
+
+struct StageResult {
+    double seconds = 0;
+    size_t iterations = 0;
+};
+
+/// @brief Run the function until enough time has passed to get a stable result.
+template <class F>
+static StageResult runStage(F&& fn) {
+    StageResult result;
+    auto start = Clock::now();
+    do {
+        fn();
+        ++result.iterations;
+    } while (Clock::now() - start < MinStageTime);
+    result.seconds = std::chrono::duration<double>(Clock::now() - start).count();
+    return result;
+}
+
+static void printHeader() {
+    std::printf("%-18s %-12s %14s %12s\n", "stage", "corpus", "ns/comment", "MB/s");
+}
+
+static void printResult(const char* stage, const char* corpus, double seconds, size_t iterations, size_t comments, size_t bytes) {
+    auto ops = static_cast<double>(iterations);
+    std::printf(
+        "%-18s %-12s %14.1f %12.2f\n",
+        stage, corpus,
+        seconds * 1e9 / (ops * comments),
+        bytes * ops / seconds / (1024.0 * 1024.0)
+    );
+}
+
+static size_t s_checksum = 0; // keeps the compiler from removing the benchmarked code
+static size_t s_failures = 0; // correctness checks that failed, the bench exits with 1 if there are any
+
+static void fail(const char* message) {
+    std::printf("FAILED %s\n", message);
+    ++s_failures;
+}
+
+/// @brief Run the physics at 60 fps until it stops, returns the frames it took (or MaxFrames if it didn't stop).
+static size_t settle(ScrollPhysics& physics) {
+    constexpr size_t MaxFrames = 60 * 10;
+    size_t frames = 0;
+    while (frames < MaxFrames && physics.update(1.0 / 60.0)) ++frames;
+    return frames;
+}
+
+int main(int argc, char** argv) {
+    std::string fnt;
+    if (argc > 1) {
+        std::ifstream file(argv[1], std::ios::binary);
+        if (!file) {
+            std::fprintf(stderr, "Failed to read '%s'\n", argv[1]);
+            return 1;
+        }
+        std::stringstream buffer;
+        buffer << file.rdbuf();
+        fnt = buffer.str();
+    } else {
+        fnt = makeSyntheticFont();
+    }
+
+    BMFontConfiguration font;
+    if (auto err = font.initWithContents(fnt)) {
+        std::fprintf(stderr, "Failed to parse font: %s\n", err->c_str());
+        return 1;
+    }
+
+    auto corpora = makeCorpora();
+    std::printf("%zu emoji placeholders, %zu sheet entries, %zu animated\n\n",
+        EmojiReplacements.size(), EmojiSheet.size(), AnimatedEmojis.size());
+    printHeader();
+
+    // font parsing
+    {
+        auto result = runStage([&] {
+            BMFontConfiguration config;
+            (void) config.initWithContents(fnt);
+            s_checksum += config.getFontDefDictionary().size();
+        });
+        printResult("fnt-parse", "-", result.seconds, result.iterations, 1, fnt.size());
+    }
+
+    // picker search, one query per keystroke
+    {
+        constexpr std::string_view queries[] = {
+            "c", "ca", "cat", "catp", "catpo", "catpog",
+            "d", "de", "dem", "demo", "demon", "ee", "zzz"
+        };
+        size_t bytes = 0;
+        for (auto query : queries) bytes += query.size();
+
+        auto result = runStage([&] {
+            for (auto query : queries) {
+                s_checksum += searchEmojis(query).size();
+            }
+        });
+        printResult("emoji-search", "-", result.seconds, result.iterations, std::size(queries), bytes);
+    }
+
+    // scroll physics behaviour, checked once
+    {
+        // pulling past the top only follows with resistance, and springs back to the edge on release
+        ScrollPhysics physics;
+        physics.setBounds(-3000.0, 0.0, 175.0);
+        physics.beginDrag(0.0);
+        physics.drag(100.0, 0.1);
+        auto overscroll = physics.getPosition();
+        physics.endDrag(0.5);
+        auto frames = settle(physics);
+        if (overscroll <= 0.0 || overscroll >= 100.0) {
+            fail("scroll-physics: overscroll isn't rubber banded");
+        }
+        if (frames >= 60 || physics.getPosition() != 0.0 || physics.isMoving()) {
+            fail("scroll-physics: rubber band doesn't settle on the edge within a second");
+        }
+
+        // smooth scrolls add up, glide to the target and stop there
+        physics.setPosition(-1000.0);
+        physics.scrollBy(-300.0, true);
+        physics.update(1.0 / 60.0);
+        physics.scrollBy(-300.0, true);
+        frames = settle(physics);
+        if (frames >= 60 || physics.getPosition() != -1600.0 || physics.isMoving() || physics.update(1.0 / 60.0)) {
+            fail("scroll-physics: glide doesn't stop on its target within a second");
+        }
+
+        // the target is clamped to the bounds
+        physics.scrollBy(-5000.0, true);
+        settle(physics);
+        if (physics.getPosition() != -3000.0 || physics.isMoving()) {
+            fail("scroll-physics: glide doesn't stop on the bottom edge");
+        }
+    }
+
+    // scroll physics, one flick into the bottom edge of a long list
+    {
+        auto fling = [](double frameRate, size_t& frames) {
+            ScrollPhysics physics;
+            physics.setBounds(-3000.0, 0.0, 175.0);
+            physics.setPosition(-2000.0);
+            physics.beginDrag(0.0);
+            for (int i = 1; i <= 6; ++i) physics.drag(-30.0, i / 120.0);
+            physics.endDrag(6 / 120.0);
+
+            frames = 0;
+            while (physics.update(1.0 / frameRate)) ++frames;
+            return physics.getPosition();
+        };
+
+        constexpr std::pair<double, const char*> rates[] = { { 60.0, "60hz" }, { 144.0, "144hz" }, { 240.0, "240hz" } };
+        size_t frames = 0;
+        for (auto [rate, name] : rates) {
+            // the flick carries past the bottom, so at every frame rate it has to bounce back onto the edge
+            if (fling(rate, frames) != -3000.0) {
+                std::printf("FAILED scroll-physics: fling doesn't settle on the bottom edge at %s\n", name);
+                ++s_failures;
+            }
+
+            auto result = runStage([&] {
+                s_checksum += static_cast<size_t>(-fling(rate, frames));
+            });
+            printResult("scroll-physics", name, result.seconds, result.iterations, frames, 0);
+        }
+    }
+
+    LayoutFont fonts[] = { { &font, std::nullopt } };
+    BenchDelegate delegate;
+    LayoutContext context{ fonts, &EmojiSheet, &delegate };
+
+    // same settings as the comment cells
+    LayoutOptions wrapped{ .extraLineSpacing = 12.f, .wrap = true, .wrapWidth = 315.f, .breakWords = 48 };
+    LayoutOptions single{};
+
+    for (auto& corpus : corpora) {
+        auto count = corpus.comments.size();
+
+        std::vector<std::string> replaced;
+        std::vector<std::u32string> decoded;
+        for (auto& comment : corpus.comments) {
+            replaced.push_back(replaceEmojis(comment));
+            decoded.push_back(utf8_to_utf32(replaced.back()));
+        }
+
+        auto result = runStage([&] {
+            for (auto& comment : corpus.comments) {
+                s_checksum += replaceEmojis(comment).size();
+            }
+        });
+        printResult("replace-emojis", corpus.name, result.seconds, result.iterations, count, corpus.bytes);
+
+        result = runStage([&] {
+            for (auto& comment : replaced) {
+                s_checksum += utf8_to_utf32(comment).size();
+            }
+        });
+        printResult("utf8-to-utf32", corpus.name, result.seconds, result.iterations, count, corpus.bytes);
+
+        result = runStage([&] {
+            for (auto& text : decoded) {
+                for (uint32_t i = 0; i < text.size(); ++i) {
+                    s_checksum += parseEmoji(text, i, &EmojiSheet).size();
+                }
+            }
+        });
+        printResult("parse-emoji", corpus.name, result.seconds, result.iterations, count, corpus.bytes);
+
+        // individual layout stages, timed around each call
+        TextLayout layout;
+        double stageTimes[4]{};
+        size_t stageIterations = 0;
+        auto start = Clock::now();
+        do {
+            for (auto& text : decoded) {
+                layout.clear();
+                auto t0 = Clock::now();
+                layout::tokenize(text, wrapped, layout);
+                auto t1 = Clock::now();
+                layout::shape(text, context, wrapped, layout);
+                auto t2 = Clock::now();
+                layout::breakLines(context, wrapped, layout);
+                auto t3 = Clock::now();
+                layout::align(wrapped, layout);
+                auto t4 = Clock::now();
+
+                stageTimes[0] += std::chrono::duration<double>(t1 - t0).count();
+                stageTimes[1] += std::chrono::duration<double>(t2 - t1).count();
+                stageTimes[2] += std::chrono::duration<double>(t3 - t2).count();
+                stageTimes[3] += std::chrono::duration<double>(t4 - t3).count();
+                s_checksum += layout.glyphs.size();
+            }
+            ++stageIterations;
+        } while (Clock::now() - start < MinStageTime);
+
+        constexpr const char* stageNames[] = { "layout-tokenize", "layout-shape", "layout-break", "layout-align" };
+        for (size_t i = 0; i < std::size(stageNames); ++i) {
+            printResult(stageNames[i], corpus.name, stageTimes[i], stageIterations, count, corpus.bytes);
+        }
+
+        result = runStage([&] {
+            for (auto& text : decoded) {
+                layoutText(text, context, wrapped, layout);
+                s_checksum += layout.getLineCount();
+            }
+        });
+        printResult("layout-wrapped", corpus.name, result.seconds, result.iterations, count, corpus.bytes);
+
+        result = runStage([&] {
+            for (auto& text : decoded) {
+                layoutText(text, context, single, layout);
+                s_checksum += layout.getLineCount();
+            }
+        });
+        printResult("layout-single", corpus.name, result.seconds, result.iterations, count, corpus.bytes);
+
+        // measuring must agree with the real line breaking
+        size_t mismatches = 0;
+        std::vector<float> lineWidths;
+        for (auto& text : decoded) {
+            layout.clear();
+            layout::tokenize(text, wrapped, layout);
+            layout::shape(text, context, wrapped, layout);
+            lineWidths.clear();
+            auto measured = layout::measureLines(context, wrapped, layout, &lineWidths);
+            layout::breakLines(context, wrapped, layout);
+            mismatches += measured.width != layout.width || measured.height != layout.height
+                || lineWidths.size() != layout.getLineCount()
+                || std::ranges::max(lineWidths) != measured.width;
+        }
+        if (mismatches) {
+            std::printf("FAILED layout-measure: %zu comments measured differently in %s\n", mismatches, corpus.name);
+            ++s_failures;
+        }
+
+        // Label::measure: plain text in the primary font, measured with measureText into a scratch layout
+        LayoutContext plain{ fonts };
+        TextLayout scratch;
+        mismatches = 0;
+        for (auto& text : decoded) {
+            for (auto* options : { &wrapped, &single }) {
+                lineWidths.clear();
+                auto measured = measureText(text, plain, *options, scratch, &lineWidths);
+                layoutText(text, plain, *options, layout);
+                mismatches += measured.width != layout.width || measured.height != layout.height
+                    || lineWidths.size() != layout.getLineCount();
+            }
+        }
+        if (mismatches) {
+            std::printf("FAILED label-measure: %zu comments measured differently in %s\n", mismatches, corpus.name);
+            ++s_failures;
+        }
+
+        // comment cells: fit into the text box, searching the scale over measurements only
+        result = runStage([&] {
+            for (auto& text : decoded) {
+                layout.clear();
+                layout::tokenize(text, wrapped, layout);
+                layout::shape(text, context, wrapped, layout);
+                auto scale = layout::fitScale(context, wrapped, layout, 315.f, 48.f, 0.5f);
+                s_checksum += static_cast<size_t>(scale * 256.f);
+            }
+        });
+        printResult("layout-fit", corpus.name, result.seconds, result.iterations, count, corpus.bytes);
+
+        result = runStage([&] {
+            for (auto& comment : corpus.comments) {
+                auto text = utf8_to_utf32(replaceEmojis(comment));
+                layoutText(text, context, wrapped, layout);
+                s_checksum += layout.getLineCount();
+            }
+        });
+        printResult("pipeline", corpus.name, result.seconds, result.iterations, count, corpus.bytes);
+    }
+
+    // fallback fonts, every character the primary font misses is looked up in the others
+    {
+        constexpr std::tuple<int, int, int> ranges[] = {
+            { 0x0391, 0x39, 34 },  // Greek
+            { 0x0410, 0x40, 40 },  // Cyrillic
+            { 0x4E00, 0x1000, 36 } // CJK
+        };
+
+        std::vector<BMFontConfiguration> configs(std::size(ranges));
+        std::vector<LayoutFont> fallbackFonts = { { &font, std::nullopt } };
+        for (size_t i = 0; i < std::size(ranges); ++i) {
+            auto [first, count, lineHeight] = ranges[i];
+            (void) configs[i].initWithContents(makeFallbackFont(first, count, lineHeight));
+            fallbackFonts.push_back({ &configs[i], std::nullopt });
+        }
+
+        Random random;
+        std::vector<std::u32string> texts;
+        size_t bytes = 0;
+        for (size_t i = 0; i < 256; ++i) {
+            std::u32string text;
+            while (text.size() < MaxCommentLength) {
+                auto [first, count, _] = ranges[random.range(std::size(ranges))];
+                auto length = 2 + random.range(6);
+                for (size_t k = 0; k < length; ++k) {
+                    text += random.range(4) == 0
+                        ? static_cast<char32_t>('a' + random.range(26))
+                        : static_cast<char32_t>(first + random.range(count));
+                }
+                text += U' ';
+            }
+            bytes += text.size() * sizeof(char32_t);
+            texts.push_back(std::move(text));
+        }
+
+        auto start = Clock::now();
+        FontFallbackIndex index(fallbackFonts);
+        auto buildTime = std::chrono::duration<double>(Clock::now() - start).count();
+        printResult("fallback-index", "build", buildTime, 1, index.size(), 0);
+
+        LayoutContext probed{ fallbackFonts, nullptr, nullptr };
+        LayoutContext indexed{ fallbackFonts, nullptr, nullptr, &index };
+
+        // both lookups must pick the same glyphs
+        size_t mismatches = 0;
+        TextLayout layout, other;
+        for (auto& text : texts) {
+            layoutText(text, probed, wrapped, layout);
+            layoutText(text, indexed, wrapped, other);
+            mismatches += !std::ranges::equal(layout.glyphs, other.glyphs, [](auto& a, auto& b) {
+                return a.def == b.def && a.font == b.font && a.scale == b.scale;
+            });
+        }
+        if (mismatches) {
+            std::printf("FAILED fallback-index: %zu comments shaped differently\n", mismatches);
+            ++s_failures;
+        }
+
+        for (auto [context, name] : { std::pair{ &probed, "probed" }, std::pair{ &indexed, "indexed" } }) {
+            auto result = runStage([&] {
+                for (auto& text : texts) {
+                    layout.clear();
+                    layout::tokenize(text, wrapped, layout);
+                    layout::shape(text, *context, wrapped, layout);
+                    s_checksum += layout.glyphs.size();
+                }
+            });
+            printResult("fallback-shape", name, result.seconds, result.iterations, texts.size(), bytes);
+        }
+    }
+
+    std::printf("\nchecksum: %zu\n", s_checksum);
+    if (s_failures) {
+        std::printf("%zu checks failed\n", s_failures);
+        return 1;
+    }
+    return 0;
+}
@@ -1,9 +1,140 @@
 #include "animated-sprite.hpp"
+#include "profiler.hpp"
+#include <Geode/loader/Mod.hpp>
+#include <Geode/utils/cocos.hpp>
+#include <chrono>
 #include <fmt/format.h>
+#include <unordered_map>
 
-FrameAnimation* FrameAnimation::create(const char* frame_prefix, size_t frame_count, float delay) {
+// Animated emojis are shipped as separate sprites instead of a spritesheet,
+// so that frames are only loaded when an animation actually gets displayed.
+// All frames of a set are requested at once with addImageAsync, so the disk reads and decoding
+// happen on the loader thread, and the set is unloaded as a whole once nothing displays it.
+struct FrameAnimation::FrameSet {
+    std::vector<geode::Ref<cocos2d::CCSpriteFrame>> frames; // loaded frames (null until their texture arrives)
+    geode::Ref<cocos2d::CCSpriteFrame> placeholder;         // blank frame shown while frames are loading
+    size_t users = 0;                                       // amount of alive animations using this set
+    size_t generation = 0;                                  // bumped on unload, textures requested before are dropped
+    bool requested = false;                                 // whether the frames were requested since the last unload
+    std::chrono::steady_clock::time_point lastUsed;         // when the last user was released
+
+    void request(std::string const& prefix);
+
+    void onLoaded(size_t index, cocos2d::CCTexture2D* texture) {
+        frames[index] = cocos2d::CCSpriteFrame::createWithTexture(texture, { { 0, 0 }, texture->getContentSize() });
+        PROFILE_COUNT(AnimationFrames, 1);
+    }
+
+    void unload() {
+        ++generation;
+        requested = false;
+
+        auto textureCache = cocos2d::CCTextureCache::get();
+        for (auto& frame : frames) {
+            if (!frame) continue;
+            textureCache->removeTexture(frame->getTexture());
+            frame = nullptr;
+        }
+    }
+};
+
+static std::unordered_map<std::string, FrameAnimation::FrameSet>& getFrameSets() {
+    static std::unordered_map<std::string, FrameAnimation::FrameSet> s_frameSets;
+    return s_frameSets;
+}
+
+/// @brief Receives one frame texture from the async loader.
+class FrameRequest final : public cocos2d::CCObject {
+public:
+    FrameRequest(std::string prefix, size_t index, size_t generation)
+        : m_prefix(std::move(prefix)), m_index(index), m_generation(generation) {}
+
+    void onLoaded(cocos2d::CCObject* object) {
+        auto texture = static_cast<cocos2d::CCTexture2D*>(object);
+        if (!texture) {
+            geode::log::warn("Failed to load animation frame {} of {}", m_index + 1, m_prefix);
+            return;
+        }
+
+        auto& sets = getFrameSets();
+        auto it = sets.find(m_prefix);
+        if (it == sets.end() || it->second.generation != m_generation) {
+            // the set was unloaded while this frame was loading
+            cocos2d::CCTextureCache::get()->removeTexture(texture);
+            return;
+        }
+        it->second.onLoaded(m_index, texture);
+    }
+
+private:
+    std::string m_prefix;
+    size_t m_index;
+    size_t m_generation;
+};
+
+void FrameAnimation::FrameSet::request(std::string const& prefix) {
+    if (requested) return;
+    requested = true;
+
+    auto textureCache = cocos2d::CCTextureCache::get();
+    for (size_t i = 0; i < frames.size(); ++i) {
+        if (frames[i]) continue;
+
+        // the cache retains the request until the texture is loaded (or calls it right away if it already is)
+        auto request = new FrameRequest(prefix, i, generation);
+        auto name = fmt::format("{}_{:03}.png", prefix, i + 1);
+        textureCache->addImageAsync(name.c_str(), request, callfuncO_selector(FrameRequest::onLoaded));
+        request->release();
+    }
+}
+
+/// @brief Fully transparent texture, stretched into the placeholder frames.
+static cocos2d::CCTexture2D* getBlankTexture() {
+    static geode::Ref<cocos2d::CCTexture2D> s_texture = [] {
+        uint8_t pixels[2 * 2 * 4] = {};
+        auto image = new cocos2d::CCImage();
+        image->initWithImageData(pixels, sizeof(pixels), cocos2d::CCImage::kFmtRawData, 2, 2, 8);
+        auto texture = new cocos2d::CCTexture2D();
+        texture->initWithImage(image);
+        texture->autorelease();
+        image->release();
+        return geode::Ref(texture);
+    }();
+    return s_texture;
+}
+
+/// @brief Periodically unloads frame sets which were not displayed for a while.
+class FrameSetCollector final : public cocos2d::CCObject {
+public:
+    static void schedule() {
+        static FrameSetCollector* s_instance = [] {
+            auto ret = new FrameSetCollector();
+            cocos2d::CCScheduler::get()->scheduleSelector(
+                schedule_selector(FrameSetCollector::sweep), ret, 5.f, false
+            );
+            return ret;
+        }();
+        (void) s_instance;
+    }
+
+    void sweep(float) {
+        auto delay = geode::Mod::get()->getSettingValue<int64_t>("unload-animated-emojis");
+        if (delay <= 0) return;
+
+        auto now = std::chrono::steady_clock::now();
+        for (auto& [_, set] : getFrameSets()) {
+            if (set.users == 0 && now - set.lastUsed >= std::chrono::seconds(delay)) {
+                set.unload();
+            }
+        }
+    }
+};
+
+FrameAnimation* FrameAnimation::create(
+    const char* frame_prefix, size_t frame_count, float delay, cocos2d::CCSize const& frameSize
+) {
     auto ret = new FrameAnimation();
-    if (ret->init(frame_prefix, frame_count, delay)) {
+    if (ret->init(frame_prefix, frame_count, delay, frameSize)) {
         ret->autorelease();
         return ret;
     }
@@ -11,29 +142,49 @@ FrameAnimation* FrameAnimation::create(const char* frame_prefix, size_t frame_co
     return nullptr;
 }
 
-bool FrameAnimation::init(const char* frame_prefix, size_t frame_count, float delay) {
+void FrameAnimation::purgeUnusedFrames() {
+    for (auto& [_, set] : getFrameSets()) {
+        if (set.users == 0) {
+            set.unload();
+        }
+    }
+}
+
+FrameAnimation::~FrameAnimation() {
+    if (m_frames && --m_frames->users == 0) {
+        m_frames->lastUsed = std::chrono::steady_clock::now();
+    }
+}
+
+bool FrameAnimation::init(const char* frame_prefix, size_t frame_count, float delay, cocos2d::CCSize const& frameSize) {
     m_frame_prefix = frame_prefix;
     m_frame_count = frame_count;
     m_delay = delay;
     m_playing = true;
 
-    for (size_t i = 1; i <= frame_count; i++) {
-        auto frame = cocos2d::CCSpriteFrameCache::sharedSpriteFrameCache()->spriteFrameByName(
-            fmt::format("{}_{:03}.png", frame_prefix, i).c_str()
-        );
-        if (frame) {
-            m_frames.push_back(frame);
-        }
+    if (frame_count == 0) {
+        return false;
     }
 
-    if (m_frames.empty()) {
-        return false;
+    auto& set = getFrameSets()[m_frame_prefix];
+    set.frames.resize(frame_count);
+    if (!set.placeholder) {
+        // the original size sets the content size, so the label can place the animation before it loads
+        auto blank = getBlankTexture();
+        set.placeholder = cocos2d::CCSpriteFrame::createWithTexture(
+            blank, { { 0, 0 }, blank->getContentSize() }, false, { 0, 0 }, frameSize
+        );
     }
 
-    if (!CCSprite::init()) {
+    if (!CCSprite::initWithSpriteFrame(set.placeholder)) {
         return false;
     }
 
+    m_frames = &set;
+    ++m_frames->users;
+    m_frames->request(m_frame_prefix);
+    FrameSetCollector::schedule();
+
     this->refreshFrame();
     this->scheduleUpdate();
 
@@ -43,6 +194,7 @@ bool FrameAnimation::init(const char* frame_prefix, size_t frame_count, float de
 void FrameAnimation::update(float delta) {
     if (!m_playing) { return; }
 
+    PROFILE_SCOPE(AnimationUpdate);
     m_elapsed += delta;
     if (m_elapsed >= m_delay) {
         int frames = m_elapsed / m_delay;
@@ -53,6 +205,6 @@ void FrameAnimation::update(float delta) {
 }
 
 void FrameAnimation::refreshFrame() {
-    auto frame = m_frames[m_current_frame];
-    this->setDisplayFrame(frame);
+    auto& frame = m_frames->frames[m_current_frame];
+    this->setDisplayFrame(frame ? frame : m_frames->placeholder);
 }
@@ -7,7 +7,12 @@
 
 class FrameAnimation : public cocos2d::CCSprite {
 public:
-    static FrameAnimation* create(const char* frame_prefix, size_t frame_count, float delay);
+    /// @brief Create an animation, frames are loaded in the background and a blank frame of the given size
+    /// (in points) is shown until they arrive.
+    static FrameAnimation* create(const char* frame_prefix, size_t frame_count, float delay, cocos2d::CCSize const& frameSize);
+
+    /// @brief Unload the frames of all animations that are not displayed anywhere.
+    static void purgeUnusedFrames();
 
     void play() { m_playing = true; }
     void pause() { m_playing = false; }
@@ -17,17 +22,22 @@ public:
     void setDelay(float delay) { m_delay = delay; }
     void setFrame(size_t frame) { m_current_frame = frame; refreshFrame(); }
 
+    ~FrameAnimation() override;
+
+    /// @brief Frames shared between all animations with the same prefix. [Internal]
+    struct FrameSet;
+
 protected:
-    bool init(const char* frame_prefix, size_t frame_count, float delay);
+    bool init(const char* frame_prefix, size_t frame_count, float delay, cocos2d::CCSize const& frameSize);
     void update(float delta) override;
     void refreshFrame();
 
 protected:
-    std::vector<cocos2d::CCSpriteFrame*> m_frames;
+    FrameSet* m_frames = nullptr;
     std::string m_frame_prefix;
     size_t m_frame_count = 0;
     size_t m_current_frame = 0;
     float m_delay = 0;
     float m_elapsed = 0;
     bool m_playing = false;
-};
\ No newline at end of file
+};
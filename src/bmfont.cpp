@@ -0,0 +1,211 @@
+#include "bmfont.hpp"
+#include <algorithm>
+#include <charconv>
+#include <cstdlib>
+#include <type_traits>
+
+/// @brief Approximate memory of a node based hash map: one node per entry and one pointer per bucket.
+template <class Map>
+static size_t getMapMemoryUsage(Map const& map) {
+    using Node = std::pair<typename Map::key_type, typename Map::mapped_type>;
+    return map.size() * (sizeof(Node) + sizeof(void*)) + map.bucket_count() * sizeof(void*);
+}
+
+#define WRAP_PARSE(expr) if (auto err = (expr)) { return err; }
+
+std::optional<std::string> BMFontConfiguration::initWithContents(std::string_view contents) {
+    std::istringstream stream{std::string(contents)};
+    std::string line;
+
+    while (std::getline(stream, line)) {
+        if (line.empty()) {
+            continue;
+        }
+
+        std::istringstream lineStream(line);
+        std::string type;
+        lineStream >> type;
+
+        if (type == "info") {
+            WRAP_PARSE(parseInfoArguments(lineStream));
+        } else if (type == "common") {
+            WRAP_PARSE(parseCommonArguments(lineStream));
+        } else if (type == "page") {
+            WRAP_PARSE(parseImageFileName(lineStream));
+        } else if (type == "char") {
+            WRAP_PARSE(parseCharacterDefinition(lineStream));
+        } else if (type == "kerning") {
+            WRAP_PARSE(parseKerningEntry(lineStream));
+        }
+    }
+
+    return std::nullopt;
+}
+
+template <class T>
+T fastParse(std::string_view str) {
+    T value{};
+    if constexpr (std::is_floating_point_v<T>) {
+        #if defined(__cpp_lib_to_chars) && __cpp_lib_to_chars >= 201611L
+        std::from_chars(str.data(), str.data() + str.size(), value);
+        #else
+        value = static_cast<T>(std::strtod(std::string(str).c_str(), nullptr));
+        #endif
+    } else {
+        std::from_chars(str.data(), str.data() + str.size(), value);
+    }
+    return value;
+}
+
+std::optional<std::string> BMFontConfiguration::parseInfoArguments(std::istringstream& line) {
+    std::string keypair;
+
+    while (line >> keypair) {
+        auto eqPos = keypair.find('=');
+        if (eqPos == std::string::npos) {
+            continue;
+        }
+
+        auto key = keypair.substr(0, eqPos);
+        auto value = keypair.substr(eqPos + 1);
+
+        if (key == "padding") {
+            std::istringstream paddingStream(value);
+            char comma;
+            paddingStream >> m_padding.left >> comma >> m_padding.top >> comma >> m_padding.right >> comma >> m_padding.bottom;
+        }
+    }
+
+    return std::nullopt;
+}
+
+std::optional<std::string> BMFontConfiguration::parseImageFileName(std::istringstream& line) {
+    std::string keypair;
+
+    while (line >> keypair) {
+        auto eqPos = keypair.find('=');
+        if (eqPos == std::string::npos) {
+            continue;
+        }
+
+        auto key = keypair.substr(0, eqPos);
+        auto value = keypair.substr(eqPos + 1);
+
+        if (key == "file") {
+            m_atlasFile = value.substr(1, value.size() - 2); // remove quotes
+        }
+    }
+
+    if (m_atlasFile.empty()) {
+        return "Failed to parse image file name";
+    }
+
+    return std::nullopt;
+}
+
+std::optional<std::string> BMFontConfiguration::parseCommonArguments(std::istringstream& line) {
+    std::string keypair;
+
+    while (line >> keypair) {
+        auto eqPos = keypair.find('=');
+        if (eqPos == std::string::npos) {
+            continue;
+        }
+
+        auto key = keypair.substr(0, eqPos);
+        auto value = keypair.substr(eqPos + 1);
+
+        if (key == "lineHeight") {
+            m_commonHeight = fastParse<float>(value);
+        } else if (key == "scaleW" || key == "scaleH") {
+            m_atlasSize = std::max(m_atlasSize, fastParse<int>(value));
+        } else if (key == "pages") {
+            if (fastParse<int>(value) != 1) {
+                return "Font must have exactly one page";
+            }
+        }
+    }
+
+    return std::nullopt;
+}
+
+std::optional<std::string> BMFontConfiguration::parseCharacterDefinition(std::istringstream& line) {
+    BMFontDef def;
+    std::string keypair;
+
+    while (line >> keypair) {
+        auto eqPos = keypair.find('=');
+        if (eqPos == std::string::npos) {
+            continue;
+        }
+
+        auto key = keypair.substr(0, eqPos);
+        auto value = keypair.substr(eqPos + 1);
+
+        if (key == "id") {
+            def.charID = fastParse<uint32_t>(value);
+        } else if (key == "x") {
+            def.rect.x = fastParse<int>(value);
+        } else if (key == "y") {
+            def.rect.y = fastParse<int>(value);
+        } else if (key == "width") {
+            def.rect.width = fastParse<int>(value);
+        } else if (key == "height") {
+            def.rect.height = fastParse<int>(value);
+        } else if (key == "xoffset") {
+            def.xOffset = fastParse<float>(value);
+        } else if (key == "yoffset") {
+            def.yOffset = fastParse<float>(value);
+        } else if (key == "xadvance") {
+            def.xAdvance = fastParse<float>(value);
+        }
+    }
+
+    m_fontDefDictionary[def.charID] = def;
+
+    return std::nullopt;
+}
+
+std::optional<std::string> BMFontConfiguration::parseKerningEntry(std::istringstream& line) {
+    std::string keypair;
+
+    while (line >> keypair) {
+        auto eqPos = keypair.find('=');
+        if (eqPos == std::string::npos) {
+            continue;
+        }
+
+        auto key = keypair.substr(0, eqPos);
+        auto value = keypair.substr(eqPos + 1);
+
+        if (key == "first") {
+            auto first = fastParse<uint32_t>(value);
+            line >> keypair;
+            eqPos = keypair.find('=');
+            if (eqPos == std::string::npos) {
+                return "Failed to parse kerning entry first";
+            }
+
+            auto second = fastParse<uint32_t>(keypair.substr(eqPos + 1));
+            line >> keypair;
+            eqPos = keypair.find('=');
+            if (eqPos == std::string::npos) {
+                return "Failed to parse kerning entry second";
+            }
+
+            auto amount = fastParse<float>(keypair.substr(eqPos + 1));
+            m_kerningDictionary[{first, second}] = amount;
+        }
+    }
+
+    return std::nullopt;
+}
+
+#undef WRAP_PARSE
+
+size_t BMFontConfiguration::getMemoryUsage() const {
+    return sizeof(BMFontConfiguration)
+        + getMapMemoryUsage(m_fontDefDictionary)
+        + getMapMemoryUsage(m_kerningDictionary)
+        + m_atlasFile.capacity() + m_atlasName.capacity();
+}
@@ -0,0 +1,121 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <optional>
+#include <sstream>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+
+// Bitmap font definitions. This header must not depend on cocos2d or Geode,
+// file loading and texture checks are done by the label (see label.cpp).
+
+struct BMKerningPair {
+    uint32_t first = 0;
+    uint32_t second = 0;
+
+    bool operator==(const BMKerningPair& other) const = default;
+
+    uint64_t toInt() const {
+        return static_cast<uint64_t>(first) << 32 | second;
+    }
+};
+
+struct BMRect {
+    float x = 0, y = 0, width = 0, height = 0;
+};
+
+struct BMFontDef {
+    uint32_t charID = 0;
+    BMRect rect;
+    float xOffset = 0;
+    float yOffset = 0;
+    float xAdvance = 0;
+};
+
+struct BMFontPadding {
+    int left = 0, top = 0, right = 0, bottom = 0;
+};
+
+template <>
+struct std::hash<BMKerningPair> {
+    size_t operator()(BMKerningPair const& pair) const noexcept {
+        return std::hash<uint64_t>()(pair.toInt());
+    }
+};
+
+/// @brief Reimplementation of the CCBMFontConfiguration class, with a few modifications to make it more modern.
+class BMFontConfiguration {
+public:
+    /// @brief Shared handle to a loaded font. The font stays alive as long as a handle does, even if the cache drops it.
+    using Handle = std::shared_ptr<const BMFontConfiguration>;
+
+    /// @brief Usage of the font cache.
+    struct CacheStats {
+        size_t fonts = 0;      // fonts in the cache
+        size_t fontsInUse = 0; // cached fonts that also have handles outside of the cache
+        size_t bytes = 0;      // approximate memory of all cached font metrics
+    };
+
+    /// @brief Get a font from the cache, loading it on first use. Returns nullptr if it can't be loaded.
+    /// Cached fonts are looked up without locking from any thread, loading has to happen on the main thread.
+    static Handle create(std::string_view fntFile);
+    /// @brief Get a font from the cache without loading it. Returns nullptr if it isn't loaded yet.
+    /// Only reads the published cache, so it never touches the file system and is safe from any thread.
+    static Handle find(std::string_view fntFile);
+    /// @brief Forget all cached fonts, so they are loaded again on next use (e.g. after a texture pack reload).
+    /// Fonts that labels still use stay alive until their handles are released.
+    static void purgeCachedData();
+    /// @brief Drop the cached fonts that nothing else holds a handle to. Returns the amount of freed bytes.
+    static size_t purgeUnusedFonts();
+    /// @brief Get the number of cached fonts and the memory of their metrics.
+    static CacheStats getCacheStats();
+
+    BMFontConfiguration() = default;
+
+    /// @brief Parse the contents of a .fnt file.
+    /// @return Error message if the file is malformed.
+    std::optional<std::string> initWithContents(std::string_view contents);
+
+protected:
+    bool initWithFNTfile(std::string_view fntFile);
+
+private:
+    std::optional<std::string> parseInfoArguments(std::istringstream& line);
+    std::optional<std::string> parseImageFileName(std::istringstream& line);
+    std::optional<std::string> parseCommonArguments(std::istringstream& line);
+    std::optional<std::string> parseCharacterDefinition(std::istringstream& line);
+    std::optional<std::string> parseKerningEntry(std::istringstream& line);
+
+public:
+    std::unordered_map<uint32_t, BMFontDef> const& getFontDefDictionary() const { return m_fontDefDictionary; }
+    std::unordered_map<BMKerningPair, float> const& getKerningDictionary() const { return m_kerningDictionary; }
+    float getCommonHeight() const { return m_commonHeight; }
+    BMFontPadding const& getPadding() const { return m_padding; }
+    std::string const& getAtlasName() const { return m_atlasName; }
+    /// @brief Atlas file name, relative to the .fnt file.
+    std::string const& getAtlasFile() const { return m_atlasFile; }
+    /// @brief Size of the atlas declared by the font (the larger of scaleW and scaleH).
+    int getAtlasSize() const { return m_atlasSize; }
+
+    /// @brief Approximate memory used by the font metrics, in bytes.
+    size_t getMemoryUsage() const;
+
+    /// @brief Get kerning between two characters, or 0 if there is none.
+    float kerningAmountForChars(uint32_t first, uint32_t second) const {
+        if (m_kerningDictionary.empty()) return 0;
+        auto it = m_kerningDictionary.find({first, second});
+        return it == m_kerningDictionary.end() ? 0 : it->second;
+    }
+
+protected:
+    std::unordered_map<uint32_t, BMFontDef> m_fontDefDictionary;
+    std::unordered_map<BMKerningPair, float> m_kerningDictionary;
+    float m_commonHeight = 0;
+    BMFontPadding m_padding;
+    std::string m_atlasFile;
+    std::string m_atlasName;
+    int m_atlasSize = 0;
+};
@@ -0,0 +1,20 @@
+#include "comment-layout.hpp"
+#include "emoji-sheets.hpp"
+#include "emojis.hpp"
+
+Label* createCommentLabel() {
+    auto label = Label::createWrapped("", "chatFont.fnt", CommentTextWidth);
+    if (!label) {
+        return nullptr;
+    }
+
+    label->setExtraLineSpacing(12.f);
+    label->setBreakWords(48);
+    label->enableCustomNodes(&CustomNodeSheet);
+    label->enableEmojis(&retainEmojiPage, &releaseEmojiPage, &EmojiSheet);
+    return label;
+}
+
+void setCommentText(Label* label, std::string_view text, bool accountComment) {
+    label->fitToBox(text, CommentTextWidth, getCommentTextHeight(accountComment), CommentTextMinScale);
+}
@@ -0,0 +1,36 @@
+#pragma once
+#include <string_view>
+#include "label.hpp"
+
+// Where CommentCell puts the text of a comment, shared by the cell hook and the comment preview.
+
+/// @brief Comment text width in CommentCell.
+constexpr float CommentTextWidth = 315.f;
+
+/// @brief Vertical center of the comment text in level comment cells.
+constexpr float LevelCommentTextY = 33.f;
+/// @brief Vertical center of the comment text in account comment (profile post) cells.
+constexpr float AccountCommentTextY = 38.f;
+/// @brief Space kept between the bottom of the comment text and the bottom of the cell.
+constexpr float CommentTextBottomMargin = 9.f;
+
+/// @brief Vertical center of the comment text in a cell.
+constexpr float getCommentTextY(bool accountComment) {
+    return accountComment ? AccountCommentTextY : LevelCommentTextY;
+}
+
+/// @brief Height of the comment text box. The text is centered vertically,
+/// so the box reaches as far up as it reaches down to the bottom margin (48 for level comments, 58 for account comments).
+constexpr float getCommentTextHeight(bool accountComment) {
+    return (getCommentTextY(accountComment) - CommentTextBottomMargin) * 2.f;
+}
+
+/// @brief Smallest scale of the comment text, anything longer is allowed to overflow.
+/// Lower than the 0.7 the old length-based scaling stopped at, since the text only gets this small when it would overflow.
+constexpr float CommentTextMinScale = 0.5f;
+
+/// @brief Create a wrapped label with the CommentCell text settings, emojis and animated emojis.
+Label* createCommentLabel();
+
+/// @brief Set the (already replaced) text of a comment label, scaled to fit the text box of a level or account comment cell.
+void setCommentText(Label* label, std::string_view text, bool accountComment);
@@ -0,0 +1,47 @@
+#include "comment-preview.hpp"
+#include "comment-layout.hpp"
+#include "emojis.hpp"
+
+CommentPreview* CommentPreview::create(CCTextInputNode* input) {
+    auto ret = new CommentPreview();
+    if (ret->init(input)) {
+        ret->autorelease();
+        return ret;
+    }
+    delete ret;
+    return nullptr;
+}
+
+bool CommentPreview::init(CCTextInputNode* input) {
+    if (!CCNode::init()) {
+        return false;
+    }
+
+    m_input = input;
+
+    m_label = createCommentLabel();
+    if (!m_label) {
+        return false;
+    }
+
+    m_label->setAnchorPoint({ 0.5f, 1.f });
+    m_label->setID("preview-label"_spr);
+    this->addChild(m_label);
+
+    this->setContentSize({ CommentTextWidth, 0.f });
+    this->scheduleUpdate();
+
+    return true;
+}
+
+void CommentPreview::update(float) {
+    std::string text = m_input->getString();
+    if (text == m_lastText) {
+        return;
+    }
+
+    // the label keeps its sprites and only updates the ones that changed
+    // the smaller level comment box, so the preview never shows more than a cell would
+    setCommentText(m_label, replaceEmojis(text), false);
+    m_lastText = std::move(text);
+}
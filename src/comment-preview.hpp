@@ -0,0 +1,22 @@
+#pragma once
+#include <cocos2d.h>
+#include <Geode/binding/CCTextInputNode.hpp>
+#include <string>
+#include <string_view>
+#include "label.hpp"
+
+/// @brief Preview of a comment being typed, rendered the same way as in CommentCell.
+/// Checks the input once per frame and only updates the label when the text changed.
+class CommentPreview final : public cocos2d::CCNode {
+public:
+    static CommentPreview* create(CCTextInputNode* input);
+
+protected:
+    bool init(CCTextInputNode* input);
+    void update(float dt) override;
+
+protected:
+    CCTextInputNode* m_input = nullptr;
+    Label* m_label = nullptr;
+    std::string m_lastText; // input text shown in the preview
+};
@@ -0,0 +1,280 @@
+#include "emoji-grid.hpp"
+#include <Geode/loader/Log.hpp>
+#include <algorithm>
+#include <cmath>
+
+constexpr int HoldActionTag = 0x1337;
+
+EmojiCell* EmojiCell::create(float size) {
+    auto ret = new EmojiCell();
+    if (ret->init(size)) {
+        ret->autorelease();
+        return ret;
+    }
+    delete ret;
+    return nullptr;
+}
+
+bool EmojiCell::init(float size) {
+    m_size = size;
+
+    m_container = CCNode::create();
+    m_container->setContentSize({ size, size });
+
+    if (!CCMenuItemSpriteExtra::init(m_container, m_container, this, menu_selector(EmojiCell::onClicked))) {
+        return false;
+    }
+
+    return true;
+}
+
+void EmojiCell::assign(EmojiGrid* grid, size_t index) {
+    m_grid = grid;
+    m_index = index;
+
+    auto const& emoji = grid->getEmoji(index);
+    if (emoji != m_emoji) {
+        m_container->removeAllChildren();
+        m_emoji = emoji;
+
+        if (auto node = grid->getDelegate()->createEmojiNode(emoji)) {
+            // scale to fit and center in the cell
+            auto contentSize = node->getContentSize();
+            auto maxSide = std::max(contentSize.width, contentSize.height);
+            if (maxSide > 0.f) node->setScale(m_size / maxSide);
+            node->setAnchorPoint({ 0.5f, 0.5f });
+            node->ignoreAnchorPointForPosition(false);
+            node->setPosition(m_size / 2, m_size / 2);
+            m_container->addChild(node);
+        } else {
+            geode::log::warn("Emoji {} not found", emoji);
+        }
+
+        this->setID(emoji);
+    }
+
+    this->setPosition(grid->getCellPosition(index));
+    grid->addChild(this);
+}
+
+void EmojiCell::unassign() {
+    // reset any pending press animation, so the cell comes back clean
+    this->stopAllActions();
+    this->setScale(m_baseScale);
+    m_cancelledTouch = false;
+    m_grid = nullptr;
+
+    // keep the scheduled animations of the emoji node alive, they are paused while detached
+    this->removeFromParentAndCleanup(false);
+}
+
+void EmojiCell::setIndex(size_t index) {
+    m_index = index;
+    this->setPosition(m_grid->getCellPosition(index));
+}
+
+void EmojiCell::onClicked(CCObject*) {
+    if (m_cancelledTouch || !m_grid) return;
+    m_grid->getDelegate()->onEmojiClicked(m_emoji);
+}
+
+void EmojiCell::onHold() {
+    m_cancelledTouch = true;
+    CCMenuItemSpriteExtra::unselected();
+    if (m_grid) {
+        // copy, the delegate might recycle this cell
+        auto emoji = m_emoji;
+        m_grid->getDelegate()->onEmojiHeld(emoji);
+    }
+}
+
+void EmojiCell::selected() {
+    m_cancelledTouch = false;
+    if (m_bEnabled) {
+        auto action = cocos2d::CCSequence::create(
+            cocos2d::CCDelayTime::create(1.5f),
+            cocos2d::CCCallFunc::create(this, callfunc_selector(EmojiCell::onHold)),
+            nullptr
+        );
+        action->setTag(HoldActionTag);
+        this->runAction(action);
+    }
+    CCMenuItemSpriteExtra::selected();
+}
+
+void EmojiCell::unselected() {
+    this->stopActionByTag(HoldActionTag);
+    CCMenuItemSpriteExtra::unselected();
+}
+
+EmojiCell* EmojiCellPool::acquire() {
+    if (m_free.empty()) {
+        return EmojiCell::create(m_cellSize);
+    }
+
+    // keep the cell alive until it is added to a grid
+    EmojiCell* cell = m_free.back();
+    cell->retain();
+    cell->autorelease();
+    m_free.pop_back();
+    return cell;
+}
+
+void EmojiCellPool::release(EmojiCell* cell) {
+    m_free.emplace_back(cell);
+    cell->unassign();
+}
+
+EmojiGrid* EmojiGrid::create(
+    std::vector<std::string> emojis, float width,
+    EmojiCellPool* pool, EmojiGridDelegate* delegate
+) {
+    auto ret = new EmojiGrid();
+    if (ret->init(std::move(emojis), width, pool, delegate)) {
+        ret->autorelease();
+        return ret;
+    }
+    delete ret;
+    return nullptr;
+}
+
+bool EmojiGrid::init(std::vector<std::string> emojis, float width, EmojiCellPool* pool, EmojiGridDelegate* delegate) {
+    if (!CCMenu::init()) {
+        return false;
+    }
+
+    m_emojis = std::move(emojis);
+    m_cells.resize(m_emojis.size(), nullptr);
+    m_pool = pool;
+    m_delegate = delegate;
+
+    auto cellSize = pool->getCellSize();
+    m_columns = std::max<size_t>(1, static_cast<size_t>((width + Gap) / (cellSize + Gap)));
+
+    this->setContentWidth(width);
+    this->reflow();
+    this->setPosition(0, 0);
+    this->setAnchorPoint({ 0, 0 });
+    this->ignoreAnchorPointForPosition(true);
+
+    return true;
+}
+
+size_t EmojiGrid::getRows() const {
+    return (m_emojis.size() + m_columns - 1) / m_columns;
+}
+
+cocos2d::CCPoint EmojiGrid::getCellPosition(size_t index) const {
+    auto cellSize = m_pool->getCellSize();
+    auto step = cellSize + Gap;
+    auto row = index / m_columns;
+    auto column = index % m_columns;
+    return {
+        column * step + cellSize / 2,
+        this->getContentHeight() - row * step - cellSize / 2
+    };
+}
+
+void EmojiGrid::updateVisibleCells(float bottom, float top) {
+    auto height = this->getContentHeight();
+    auto step = m_pool->getCellSize() + Gap;
+    auto rows = getRows();
+
+    size_t first = 0, last = 0;
+    if (rows > 0 && top >= 0.f && bottom <= height) {
+        // rows are counted from the top
+        auto firstRow = static_cast<size_t>(std::max(0.f, std::floor((height - top) / step)));
+        auto lastRow = static_cast<size_t>(std::max(0.f, std::floor((height - bottom) / step)));
+        firstRow = firstRow > OverscanRows ? firstRow - OverscanRows : 0;
+        lastRow = std::min(lastRow + OverscanRows, rows - 1);
+
+        first = firstRow * m_columns;
+        last = std::min(m_emojis.size(), (lastRow + 1) * m_columns);
+    }
+
+    // recycle cells that went out of view
+    for (size_t i = m_firstVisible; i < m_lastVisible; ++i) {
+        if (i < first || i >= last) {
+            this->releaseCell(i);
+        }
+    }
+
+    // and fill the new ones
+    for (size_t i = first; i < last; ++i) {
+        if (!m_cells[i]) {
+            auto cell = m_pool->acquire();
+            cell->assign(this, i);
+            m_cells[i] = cell;
+        }
+    }
+
+    m_firstVisible = first;
+    m_lastVisible = last;
+}
+
+void EmojiGrid::releaseCell(size_t index) {
+    auto cell = m_cells[index];
+    if (!cell) return;
+
+    if (m_pSelectedItem == cell) {
+        m_pSelectedItem = nullptr;
+        m_eState = cocos2d::kCCMenuStateWaiting;
+    }
+
+    m_pool->release(cell);
+    m_cells[index] = nullptr;
+}
+
+void EmojiGrid::releaseCells() {
+    for (size_t i = m_firstVisible; i < m_lastVisible; ++i) {
+        this->releaseCell(i);
+    }
+    m_firstVisible = m_lastVisible = 0;
+}
+
+void EmojiGrid::reflow() {
+    auto rows = getRows();
+    auto cellSize = m_pool->getCellSize();
+    this->setContentHeight(rows == 0 ? 0.f : rows * cellSize + (rows - 1) * Gap);
+
+    for (size_t i = m_firstVisible; i < m_lastVisible; ++i) {
+        if (m_cells[i]) m_cells[i]->setIndex(i);
+    }
+}
+
+void EmojiGrid::insertEmoji(size_t index, std::string emoji) {
+    m_emojis.insert(m_emojis.begin() + index, std::move(emoji));
+    m_cells.insert(m_cells.begin() + index, nullptr);
+
+    // keep the visible range covering the same cells
+    if (index < m_firstVisible) {
+        ++m_firstVisible;
+        ++m_lastVisible;
+    } else if (index < m_lastVisible) {
+        ++m_lastVisible;
+    }
+
+    this->reflow();
+}
+
+void EmojiGrid::removeEmoji(size_t index) {
+    this->releaseCell(index);
+    m_emojis.erase(m_emojis.begin() + index);
+    m_cells.erase(m_cells.begin() + index);
+
+    if (index < m_firstVisible) {
+        --m_firstVisible;
+        --m_lastVisible;
+    } else if (index < m_lastVisible) {
+        --m_lastVisible;
+    }
+
+    this->reflow();
+}
+
+void EmojiGrid::setEmojis(std::vector<std::string> emojis) {
+    this->releaseCells();
+    m_emojis = std::move(emojis);
+    m_cells.assign(m_emojis.size(), nullptr);
+    this->reflow();
+}
@@ -0,0 +1,116 @@
+#pragma once
+#include <cocos2d.h>
+#include <Geode/binding/CCMenuItemSpriteExtra.hpp>
+#include <Geode/utils/cocos.hpp>
+#include <string>
+#include <string_view>
+#include <vector>
+
+class EmojiGrid;
+
+class EmojiGridDelegate {
+public:
+    virtual ~EmojiGridDelegate() = default;
+    /// @brief Create the node displayed for an emoji. Will be scaled to fit the cell.
+    virtual cocos2d::CCNode* createEmojiNode(std::string_view emoji) = 0;
+    virtual void onEmojiClicked(std::string const& emoji) = 0;
+    virtual void onEmojiHeld(std::string const& emoji) = 0;
+};
+
+/// @brief Button shell with a fixed size, that can be reassigned to any emoji of any grid.
+class EmojiCell final : public CCMenuItemSpriteExtra {
+public:
+    static EmojiCell* create(float size);
+
+    /// @brief Assign the cell to an emoji of a grid. The emoji node is only recreated if the emoji changed.
+    void assign(EmojiGrid* grid, size_t index);
+    /// @brief Detach the cell from its grid.
+    void unassign();
+    /// @brief Move the cell to another index of the same grid, keeping its emoji.
+    void setIndex(size_t index);
+
+    [[nodiscard]] size_t getIndex() const { return m_index; }
+
+protected:
+    bool init(float size);
+
+    void onClicked(CCObject*);
+    void onHold();
+    void selected() override;
+    void unselected() override;
+
+protected:
+    CCNode* m_container = nullptr;  // fixed size container for the emoji node
+    EmojiGrid* m_grid = nullptr;    // grid the cell is assigned to
+    size_t m_index = 0;             // index of the emoji in the grid
+    std::string m_emoji;            // emoji currently displayed
+    float m_size = 0.f;             // cell size
+    bool m_cancelledTouch = false;
+};
+
+/// @brief Reusable cells, shared between all grids of a picker (and the cached sections).
+class EmojiCellPool {
+public:
+    explicit EmojiCellPool(float cellSize) : m_cellSize(cellSize) {}
+
+    /// @brief Get a free cell, or create a new one.
+    EmojiCell* acquire();
+    /// @brief Remove the cell from its grid and keep it for later use.
+    void release(EmojiCell* cell);
+
+    [[nodiscard]] float getCellSize() const { return m_cellSize; }
+
+protected:
+    std::vector<geode::Ref<EmojiCell>> m_free;
+    float m_cellSize;
+};
+
+/// @brief Grid of emoji buttons that only creates cells for rows inside the visible area.
+/// All cells have the same size, so positions are computed directly from the index.
+class EmojiGrid final : public cocos2d::CCMenu {
+public:
+    static constexpr float Gap = 5.f;          // gap between cells
+    static constexpr size_t OverscanRows = 1;  // rows kept alive outside the visible area
+
+    static EmojiGrid* create(
+        std::vector<std::string> emojis, float width,
+        EmojiCellPool* pool, EmojiGridDelegate* delegate
+    );
+
+    /// @brief Create cells for rows between bottom and top (in node space), and recycle the rest.
+    void updateVisibleCells(float bottom, float top);
+    /// @brief Return all cells to the pool. Must be called before the grid is discarded, if the pool outlives it.
+    void releaseCells();
+
+    /// @brief Insert an emoji, shifting the existing cells instead of recreating them.
+    /// Call updateVisibleCells afterwards to fill the new cell.
+    void insertEmoji(size_t index, std::string emoji);
+    /// @brief Remove an emoji, shifting the existing cells instead of recreating them.
+    void removeEmoji(size_t index);
+    /// @brief Replace all emojis.
+    void setEmojis(std::vector<std::string> emojis);
+
+    [[nodiscard]] std::string const& getEmoji(size_t index) const { return m_emojis[index]; }
+    [[nodiscard]] std::vector<std::string> const& getEmojis() const { return m_emojis; }
+    [[nodiscard]] size_t getEmojiCount() const { return m_emojis.size(); }
+    [[nodiscard]] size_t getColumns() const { return m_columns; }
+    [[nodiscard]] size_t getRows() const;
+    [[nodiscard]] cocos2d::CCPoint getCellPosition(size_t index) const;
+    [[nodiscard]] EmojiGridDelegate* getDelegate() const { return m_delegate; }
+    void setDelegate(EmojiGridDelegate* delegate) { m_delegate = delegate; }
+
+protected:
+    bool init(std::vector<std::string> emojis, float width, EmojiCellPool* pool, EmojiGridDelegate* delegate);
+    void releaseCell(size_t index);
+    /// @brief Recalculate the height and move all cells to their positions.
+    void reflow();
+
+protected:
+    std::vector<std::string> m_emojis;     // emoji placeholders
+    std::vector<EmojiCell*> m_cells;       // cell assigned to each emoji (null if not visible)
+    EmojiCellPool* m_pool = nullptr;       // pool to take cells from
+    EmojiGridDelegate* m_delegate = nullptr;
+    size_t m_columns = 1;                  // cells per row
+    size_t m_firstVisible = 0;             // first emoji with a cell
+    size_t m_lastVisible = 0;              // one past the last emoji with a cell
+};
@@ -1,16 +1,33 @@
 #include "emoji-picker.hpp"
+#include "emoji-search.hpp"
+#include "emoji-sheets.hpp"
 #include "emojis.hpp"
+#include "profiler.hpp"
+#include "usage-stats.hpp"
 #include <Geode/binding/CCTextInputNode.hpp>
 #include <Geode/ui/Notification.hpp>
+#include <Geode/ui/TextInput.hpp>
 
 constexpr float ScrollViewHeight = 200.f;
 constexpr float ScrollViewWidth = 300.f;
 constexpr float ScrollGap = 2.5f;
+constexpr float SearchBarHeight = 25.f;
+constexpr float GridViewHeight = ScrollViewHeight - SearchBarHeight;
+constexpr size_t SearchResultsSection = 0; // always the first section, hidden when not searching
+
+struct EmojiPicker::SectionCache {
+    geode::Ref<CCNode> root;              // parent of the sections while no picker displays them
+    std::vector<Section> sections;
+    std::shared_ptr<EmojiCellPool> pool;  // the grids point to it, so it has to stay with them
+    EmojiPicker* owner = nullptr;         // picker the sections were built for or lent to
+};
 
-// https://github.com/TheSillyDoggo/Comment-Emojis/blob/main/src/CCProxyNode.cpp
+// based on https://github.com/TheSillyDoggo/Comment-Emojis/blob/main/src/CCProxyNode.cpp
+/// @brief Shows a text input that lives somewhere else in the scene.
+/// The input is rendered into a texture, which is only redrawn when its text, cursor or blink state changes.
 class ProxyNode final : public cocos2d::CCNode {
 public:
-    static ProxyNode* create(CCNode* node) {
+    static ProxyNode* create(CCTextInputNode* node) {
         auto ret = new ProxyNode();
         ret->m_node = node;
         ret->autorelease();
@@ -19,89 +36,81 @@ public:
 
     void visit() override {
         if (!m_node) return;
-        this->setContentSize(m_node->getContentSize());
+        if (this->hasChanged()) this->refresh();
         CCNode::visit();
     }
 
-    void draw() override {
-        auto originalPos = m_node->getPosition();
-        m_node->setPosition(
-            m_node->isIgnoreAnchorPointForPosition()
-                ? cocos2d::CCSize {0.f, 0.f}
-                : m_node->getContentSize() * m_node->getAnchorPoint()
-        );
-
-        m_node->visit();
-        m_node->setPosition(originalPos);
-    }
-
-    CCNode* getNode() const { return m_node; }
+    CCTextInputNode* getNode() const { return m_node; }
 
 protected:
-    geode::Ref<CCNode> m_node = nullptr;
-};
-
-class FeedbackButton final : public CCMenuItemSpriteExtra {
-public:
-    static FeedbackButton* create(
-        CCNode* node, std::function<void()> const& callback,
-        std::function<void()> const& onHold = nullptr
-    ) {
-        auto ret = new FeedbackButton();
-        if (ret->init(node, callback, onHold)) {
-            ret->autorelease();
-            return ret;
+    struct Snapshot {
+        std::string text;
+        int cursor = -1;
+        bool cursorVisible = false;
+        GLubyte cursorOpacity = 0;
+        cocos2d::CCPoint cursorPosition;
+        cocos2d::CCSize size;
+
+        bool operator==(Snapshot const& other) const {
+            return text == other.text && cursor == other.cursor
+                && cursorVisible == other.cursorVisible && cursorOpacity == other.cursorOpacity
+                && cursorPosition.equals(other.cursorPosition) && size.equals(other.size);
         }
-        delete ret;
-        return nullptr;
-    }
-
-protected:
-    void onClicked(CCObject*) {
-        if (m_cancelledTouch) return;
-        m_callback();
-    }
-
-    void onHold() {
-        m_cancelledTouch = true;
-        CCMenuItemSpriteExtra::unselected();
-        m_onHold();
-    }
-
-    void selected() override {
-        m_cancelledTouch = false;
-        if (m_bEnabled) {
-            auto action = cocos2d::CCSequence::create(
-                cocos2d::CCDelayTime::create(1.5f),
-                cocos2d::CCCallFunc::create(this, callfunc_selector(FeedbackButton::onHold)),
-                nullptr
-            );
-            action->setTag(0x1337);
-            this->runAction(action);
+    };
+
+    Snapshot takeSnapshot() const {
+        Snapshot snapshot;
+        snapshot.text = m_node->getString();
+        snapshot.cursor = m_node->m_textField ? m_node->m_textField->m_uCursorPos : -1;
+        if (auto cursor = m_node->m_cursor) {
+            snapshot.cursorVisible = cursor->isVisible();
+            snapshot.cursorOpacity = cursor->getOpacity();
+            snapshot.cursorPosition = cursor->getPosition();
         }
-        CCMenuItemSpriteExtra::selected();
+        snapshot.size = m_node->getScaledContentSize();
+        return snapshot;
     }
 
-    void unselected() override {
-        this->stopActionByTag(0x1337);
-        CCMenuItemSpriteExtra::unselected();
+    bool hasChanged() {
+        auto snapshot = this->takeSnapshot();
+        if (m_texture && snapshot == m_snapshot) return false;
+        m_snapshot = std::move(snapshot);
+        return true;
     }
 
-    bool init(CCNode* node, std::function<void()> callback, std::function<void()> onHold) {
-        m_callback = std::move(callback);
-        m_onHold = std::move(onHold);
-
-        if (!CCMenuItemSpriteExtra::init(node, node, this, menu_selector(FeedbackButton::onClicked))) {
-            return false;
+    void refresh() {
+        auto size = m_snapshot.size;
+        if (size.width <= 0.f || size.height <= 0.f) return;
+
+        if (!m_texture || !m_texture->getContentSize().equals(size)) {
+            if (m_texture) m_texture->removeFromParent();
+            m_texture = cocos2d::CCRenderTexture::create(size.width, size.height);
+            if (!m_texture) return;
+            m_texture->setContentSize(size);
+            m_texture->setPosition(size / 2.f);
+            this->addChild(m_texture);
+            this->setContentSize(size);
         }
 
-        return true;
+        // draw the input with its bottom left corner at the origin of the texture
+        auto originalPos = m_node->getPosition();
+        m_node->setPosition(
+            m_node->isIgnoreAnchorPointForPosition()
+                ? cocos2d::CCSize {0.f, 0.f}
+                : size * m_node->getAnchorPoint()
+        );
+
+        m_texture->beginWithClear(0.f, 0.f, 0.f, 0.f);
+        m_node->visit();
+        m_texture->end();
+
+        m_node->setPosition(originalPos);
     }
 
 protected:
-    std::function<void()> m_callback = nullptr;
-    std::function<void()> m_onHold = nullptr;
-    bool m_cancelledTouch = false;
+    geode::Ref<CCTextInputNode> m_node = nullptr;
+    cocos2d::CCRenderTexture* m_texture = nullptr; // holds the last rendering of the input
+    Snapshot m_snapshot;                           // input state the texture was rendered with
 };
 
 int64_t getUIScale() {
@@ -127,6 +136,29 @@ inline cocos2d::extension::CCScale9Sprite* createBackground(float width, float h
     return background;
 }
 
+// favorites and frequently used change between openings, so they're never cached
+static bool isDynamicCategory(std::string_view name) {
+    return name == "Favorites" || name == "Frequently Used";
+}
+
+/// @brief Delegate of the cached grids while no picker owns them, only creates the emoji nodes.
+class PrewarmDelegate final : public EmojiGridDelegate {
+public:
+    cocos2d::CCNode* createEmojiNode(std::string_view emoji) override {
+        return EmojiPicker::createEmojiSprite(emoji);
+    }
+    void onEmojiClicked(std::string const&) override {}
+    void onEmojiHeld(std::string const&) override {}
+};
+
+static PrewarmDelegate s_prewarmDelegate;
+
+$execute {
+    geode::listenForSettingChanges<bool>("cache-emoji-picker", [](bool value) {
+        if (!value) EmojiPicker::purgeSectionCache();
+    });
+}
+
 EmojiPicker* EmojiPicker::create(CCTextInputNode* input) {
     auto ret = new EmojiPicker();
     if (ret->initAnchored(360.f, ScrollViewHeight + 11.f, input, "geode.loader/GE_square01.png")) {
@@ -138,16 +170,37 @@ EmojiPicker* EmojiPicker::create(CCTextInputNode* input) {
 }
 
 bool EmojiPicker::setup(CCTextInputNode* input) {
+    PROFILE_SCOPE(PickerSetup);
+
     m_originalField = input;
+    // reuse the pool of the cached sections, unless the UI scale changed since they were built
+    auto& cache = getSectionCache();
+    auto cellSize = 18.f * getUIScaleF();
+    if (cache.pool && !cache.owner && cache.pool->getCellSize() == cellSize) {
+        m_cellPool = cache.pool;
+    } else {
+        m_cellPool = std::make_shared<EmojiCellPool>(cellSize);
+    }
 
     m_sidebarPanel = ScrollLayer::create({ 27.f, ScrollViewHeight - 5.f }, false);
     m_sidebarPanel->setID("sidebar-panel"_spr);
     m_mainLayer->addChildAtPosition(m_sidebarPanel, geode::Anchor::BottomLeft, { 8.f, 8.f });
 
-    m_scrollLayer = ScrollLayer::create({ ScrollViewWidth, ScrollViewHeight });
+    m_scrollLayer = ScrollLayer::create({ ScrollViewWidth, GridViewHeight });
     m_scrollLayer->setID("scroll-layer"_spr);
     m_mainLayer->addChildAtPosition(m_scrollLayer, geode::Anchor::BottomLeft, { 40.f, 5.5f });
 
+    m_searchInput = geode::TextInput::create(ScrollViewWidth / 0.7f, "Search emojis...", "chatFont.fnt");
+    m_searchInput->setScale(0.7f);
+    m_searchInput->setID("search-input"_spr);
+    m_searchInput->setCallback([this](std::string const& text) {
+        this->setSearchQuery(text);
+    });
+    m_mainLayer->addChildAtPosition(
+        m_searchInput, geode::Anchor::BottomLeft,
+        { 40.f + ScrollViewWidth * 0.5f, 5.5f + GridViewHeight + SearchBarHeight * 0.5f }
+    );
+
     recreateGroups();
 
     auto bg = createBackground(27.f, ScrollViewHeight - 5.f);
@@ -155,23 +208,14 @@ bool EmojiPicker::setup(CCTextInputNode* input) {
     bg->setAnchorPoint({ 0, 0 });
     m_mainLayer->addChildAtPosition(bg, geode::Anchor::BottomLeft, { 8.f, 8.f });
 
-    m_scrollLayer->m_contentLayer->setLayout(
-        geode::ColumnLayout::create()
-            ->setAxisReverse(true)
-            ->setAutoScale(false)
-            ->setAxisAlignment(geode::AxisAlignment::End)
-            ->setCrossAxisAlignment(geode::AxisAlignment::Center)
-            ->setCrossAxisLineAlignment(geode::AxisAlignment::Center)
-            ->setCrossAxisOverflow(false)
-            ->setGap(ScrollGap)
-    );
-
     m_sidebarPanel->scrollToTop();
     m_scrollLayer->scrollToTop();
+    this->updateVisibleCells();
+    this->scheduleUpdate();
 
     m_scrollbar = geode::Scrollbar::create(m_scrollLayer);
     m_scrollbar->setID("scrollbar"_spr);
-    m_mainLayer->addChildAtPosition(m_scrollbar, geode::Anchor::Right, { -10.f, 0.f });
+    m_mainLayer->addChildAtPosition(m_scrollbar, geode::Anchor::Right, { -10.f, -SearchBarHeight * 0.5f });
 
     m_buttonMenu->setVisible(false);
     m_mainLayer->setPositionY(m_mainLayer->getPositionY() - 40.f);
@@ -224,11 +268,167 @@ bool EmojiPicker::setup(CCTextInputNode* input) {
     return true;
 }
 
-void EmojiPicker::recreateGroups() const {
+EmojiPicker::~EmojiPicker() {
+    this->storeCachedSections();
+}
+
+EmojiPicker::SectionCache& EmojiPicker::getSectionCache() {
+    // never destroyed, the nodes can't outlive the director
+    static auto cache = new SectionCache();
+    return *cache;
+}
+
+bool EmojiPicker::isSectionCacheEnabled() {
+    return geode::Mod::get()->getSettingValue<bool>("cache-emoji-picker");
+}
+
+void EmojiPicker::purgeSectionCache() {
+    auto& cache = getSectionCache();
+    cache.sections.clear();
+    if (cache.root) cache.root->removeAllChildren();
+    cache.pool = nullptr;
+    // an open picker builds new sections on its next rebuild
+    cache.owner = nullptr;
+}
+
+bool EmojiPicker::adoptCachedSections() {
+    auto& cache = getSectionCache();
+    if (!isSectionCacheEnabled() || (cache.owner && cache.owner != this)) {
+        return false;
+    }
+    cache.owner = this;
+
+    // the cells of the cached grids come from another pool
+    if (cache.pool != m_cellPool) {
+        purgeSectionCache();
+        cache.owner = this;
+        cache.pool = m_cellPool;
+        return false;
+    }
+    if (cache.sections.empty()) {
+        return false;
+    }
+
+    for (auto& section : cache.sections) {
+        section.header->removeFromParentAndCleanup(false);
+        section.body->removeFromParentAndCleanup(false);
+        m_sectionStack->addChild(section.header);
+        m_sectionStack->addChild(section.body);
+        section.grid->setDelegate(this);
+        section.toggle->setTarget(this, menu_selector(EmojiPicker::onToggleSection));
+        m_sections.push_back(std::move(section));
+    }
+    cache.sections.clear();
+
+    return true;
+}
+
+void EmojiPicker::storeCachedSections() {
+    auto& cache = getSectionCache();
+    if (cache.owner != this) {
+        return;
+    }
+    cache.owner = nullptr;
+
+    if (!cache.root) {
+        cache.root = CCNode::create();
+    }
+
+    auto first = std::min(m_firstStaticSection, m_sections.size());
+    for (size_t i = first; i < m_sections.size(); ++i) {
+        auto& section = m_sections[i];
+        section.grid->releaseCells();
+        section.grid->setDelegate(&s_prewarmDelegate);
+        section.toggle->setTarget(nullptr, nullptr);
+        section.header->removeFromParentAndCleanup(false);
+        section.body->removeFromParentAndCleanup(false);
+        cache.root->addChild(section.header);
+        cache.root->addChild(section.body);
+        cache.sections.push_back(std::move(section));
+    }
+    m_sections.erase(m_sections.begin() + first, m_sections.end());
+}
+
+bool EmojiPicker::prewarmNextSection() {
+    auto& cache = getSectionCache();
+    if (!isSectionCacheEnabled() || cache.owner) {
+        return false;
+    }
+
+    auto cellSize = 18.f * getUIScaleF();
+    if (!cache.pool || cache.pool->getCellSize() != cellSize) {
+        purgeSectionCache();
+        cache.pool = std::make_shared<EmojiCellPool>(cellSize);
+    }
+    if (!cache.root) {
+        cache.root = CCNode::create();
+    }
+
+    // build the static categories in display order, same as recreateGroups
+    for (auto& category : getEmojiCategories()) {
+        if (category.emojis.empty() || isDynamicCategory(category.name) || !hasEmojiSprite(category.icon)) {
+            continue;
+        }
+
+        auto built = std::ranges::any_of(cache.sections, [&](Section const& section) {
+            return section.name == category.name;
+        });
+        if (built) continue;
+
+        auto section = createSection(category, cache.pool.get(), nullptr);
+        cache.root->addChild(section.header);
+        cache.root->addChild(section.body);
+        cache.sections.push_back(std::move(section));
+        return true;
+    }
+
+    return false;
+}
+
+void EmojiPicker::prewarmVisibleCells() {
+    auto& cache = getSectionCache();
+    if (cache.owner || !cache.pool) {
+        return;
+    }
+
+    // fill the rows shown at the top of the first static sections,
+    // the picker releases them on open if favorites push them out of view
+    float remaining = GridViewHeight;
+    for (auto& section : cache.sections) {
+        if (remaining <= 0.f) break;
+        remaining -= section.header->getContentHeight() + ScrollGap;
+        if (section.collapsed) continue;
+
+        auto grid = section.grid;
+        auto height = grid->getContentHeight();
+        grid->setDelegate(&s_prewarmDelegate);
+        grid->updateVisibleCells(height - std::max(remaining, 0.f), height);
+        remaining -= section.body->getContentHeight() + ScrollGap;
+    }
+}
+
+void EmojiPicker::recreateGroups() {
+    // the static sections survive the rebuild
+    this->storeCachedSections();
+
+    // give the buttons back before the grids are gone
+    for (auto& section : m_sections) {
+        section.grid->releaseCells();
+    }
+    m_sections.clear();
+
     // remove all children
     m_scrollLayer->m_contentLayer->removeAllChildren();
     m_sidebarPanel->m_contentLayer->removeAllChildren();
 
+    // sections hang from the top of the content layer, so resizing it doesn't move them
+    m_sectionStack = CCNode::create();
+    m_sectionStack->setID("sections"_spr);
+    m_sectionStack->setAnchorPoint({ 0, 0 });
+    m_scrollLayer->m_contentLayer->addChild(m_sectionStack);
+
+    appendGroup({ "Search Results", "", {} });
+
     auto sidebarMenu = cocos2d::CCMenu::create();
     sidebarMenu->setAnchorPoint({ 0, 0 });
     sidebarMenu->setPosition({ 0, 0 });
@@ -239,12 +439,17 @@ void EmojiPicker::recreateGroups() const {
     dummy->setContentSize({ 27, 0 });
     sidebarMenu->addChild(dummy);
 
+    // favorites and frequently used come first, and are rebuilt every time
+    std::optional<size_t> firstStatic;
+    bool cached = false;
+
     for (auto& category : getEmojiCategories()) {
         if (category.emojis.empty()) {
             continue;
         }
 
         CCNode* first = nullptr;
+        bool isStatic = !isDynamicCategory(category.name);
 
         if (category.name == "Frequently Used") {
             first = cocos2d::CCSprite::createWithSpriteFrameName("GJ_timeIcon_001.png");
@@ -257,28 +462,39 @@ void EmojiPicker::recreateGroups() const {
         if (!first) { continue; }
         first = encloseInContainer(first, 18.f);
 
-        auto groupTop = appendGroup(category);
+        if (isStatic && !firstStatic) {
+            firstStatic = m_sections.size();
+            cached = this->adoptCachedSections();
+        }
+
+        // a prewarm might have been interrupted, the missing sections are always the last ones
+        CCNode* groupTop = nullptr;
+        if (auto index = cached ? findSection(category.name) : std::nullopt) {
+            groupTop = m_sections[*index].header;
+        } else {
+            groupTop = appendGroup(category);
+        }
+
         auto btn = geode::cocos::CCMenuItemExt::createSpriteExtra(
             first, [this, groupTop](auto) {
+                // categories are hidden while searching
+                if (!m_searchQuery.empty()) {
+                    m_searchInput->setString("");
+                    this->setSearchQuery("");
+                }
                 m_scrollLayer->scrollTo(groupTop);
             }
         );
         sidebarMenu->addChild(btn);
     }
 
-    // add dummy node to pad the bottom
-    dummy = CCNode::create();
-    dummy->setContentSize({ ScrollViewWidth, 0 });
-    m_scrollLayer->m_contentLayer->addChild(dummy);
+    m_firstStaticSection = firstStatic.value_or(m_sections.size());
 
-    // calculate required height
-    float height = -ScrollGap;
-    for (auto child : geode::cocos::CCArrayExt<CCNode*>(m_scrollLayer->m_contentLayer->getChildren())) {
-        height += child->getContentSize().height + ScrollGap;
-    }
-    m_scrollLayer->m_contentLayer->setContentHeight(std::max(height, ScrollViewHeight));
+    this->applySearch();
+    this->layoutSections(0);
+    this->updateScrollLayer();
 
-    height = -5.f;
+    float height = -5.f;
     for (auto child : geode::cocos::CCArrayExt<CCNode*>(sidebarMenu->getChildren())) {
         height += child->getContentSize().height + 5.f;
     }
@@ -300,25 +516,16 @@ void EmojiPicker::recreateGroups() const {
 }
 
 cocos2d::CCNode* EmojiPicker::createEmojiSprite(std::string_view emoji) {
-    std::string_view emojiView;
-    bool found = false;
-    for (auto& [name, content] : EmojiReplacements) {
-        if (name == emoji) {
-            emojiView = content;
-            found = true;
-            break;
-        }
-    }
-
-    if (!found) {
+    auto entry = findEmoji(emoji);
+    if (!entry) {
         return nullptr;
     }
 
-    auto utf32 = utf8_to_utf32(emojiView);
+    auto utf32 = utf8_to_utf32(entry->emoji);
 
     auto utf32_raw = std::u32string_view(utf32.data(), utf32.size());
     if (auto it = EmojiSheet.find(utf32_raw); it != EmojiSheet.end()) {
-        return cocos2d::CCSprite::createWithSpriteFrameName(it->second);
+        return createEmojiPageSprite(it->second);
     }
 
     if (auto it = CustomNodeSheet.find(utf32_raw); it != CustomNodeSheet.end()) {
@@ -329,6 +536,23 @@ cocos2d::CCNode* EmojiPicker::createEmojiSprite(std::string_view emoji) {
     return nullptr;
 }
 
+bool EmojiPicker::hasEmojiSprite(std::string_view emoji) {
+    auto entry = findEmoji(emoji);
+    if (!entry) {
+        return false;
+    }
+
+    auto utf32 = utf8_to_utf32(entry->emoji);
+
+    auto utf32_raw = std::u32string_view(utf32.data(), utf32.size());
+    if (auto it = EmojiSheet.find(utf32_raw); it != EmojiSheet.end()) {
+        if (!loadEmojiPage(it->second.page)) { return false; }
+        return cocos2d::CCSpriteFrameCache::get()->spriteFrameByName(it->second.name) != nullptr;
+    }
+
+    return CustomNodeSheet.contains(utf32_raw);
+}
+
 cocos2d::CCNode* EmojiPicker::encloseInContainer(CCNode* node, float size) {
     auto contentSize = node->getContentSize();
     if (contentSize.width != size || contentSize.height != size) {
@@ -365,23 +589,8 @@ std::vector<EmojiCategory> const& EmojiPicker::getEmojiCategories() {
 }
 
 std::vector<std::string> EmojiPicker::getFrequentlyUsedEmojis() {
-    auto emojis = geode::Mod::get()->getSavedValue<std::map<std::string, uint64_t>>("frequently-used-emojis", {});
-
-    std::vector<std::pair<std::string, uint64_t>> sortedEmojis(emojis.begin(), emojis.end());
-    std::ranges::sort(sortedEmojis, [](auto const& a, auto const& b) {
-        return a.second > b.second;
-    });
-
-    auto size = std::min<int64_t>(sortedEmojis.size(), geode::Mod::get()->getSettingValue<int64_t>("frequently-used-emojis-limit"));
-
-    // return the top N emojis
-    std::vector<std::string> result;
-    result.reserve(size);
-    for (int64_t i = 0; i < size; ++i) {
-        result.push_back(sortedEmojis[i].first);
-    }
-
-    return result;
+    auto limit = geode::Mod::get()->getSettingValue<int64_t>("frequently-used-emojis-limit");
+    return UsageStats::get().getTop(std::max<int64_t>(limit, 0));
 }
 
 std::vector<std::string> EmojiPicker::getFavoriteEmojis() {
@@ -389,9 +598,7 @@ std::vector<std::string> EmojiPicker::getFavoriteEmojis() {
 }
 
 void EmojiPicker::incrementEmojiUsage(std::string const& emoji) {
-    auto emojis = geode::Mod::get()->getSavedValue<std::map<std::string, uint64_t>>("frequently-used-emojis", {});
-    emojis[emoji] += 1;
-    geode::Mod::get()->setSavedValue("frequently-used-emojis", emojis);
+    UsageStats::get().increment(emoji);
 }
 
 void EmojiPicker::toggleFavoriteEmoji(std::string const& emoji) {
@@ -413,9 +620,15 @@ void EmojiPicker::toggleFavoriteEmoji(std::string const& emoji) {
     )->show();
 }
 
-cocos2d::CCNode* EmojiPicker::appendGroup(EmojiCategory const& category) const {
-    auto contentLayer = m_scrollLayer->m_contentLayer;
+cocos2d::CCNode* EmojiPicker::appendGroup(EmojiCategory const& category) {
+    auto section = createSection(category, m_cellPool.get(), this);
+    m_sectionStack->addChild(section.header);
+    m_sectionStack->addChild(section.body);
+    m_sections.push_back(std::move(section));
+    return m_sections.back().header;
+}
 
+EmojiPicker::Section EmojiPicker::createSection(EmojiCategory const& category, EmojiCellPool* pool, EmojiPicker* owner) {
     auto title = Label::create(category.name, "chatFont.fnt");
     title->setID("emoji-category-title"_spr);
     title->setScale(0.7f);
@@ -424,62 +637,13 @@ cocos2d::CCNode* EmojiPicker::appendGroup(EmojiCategory const& category) const {
     auto titleMenu = cocos2d::CCMenu::create();
     titleMenu->setContentSize({ ScrollViewWidth, title->getContentHeight() });
     titleMenu->setAnchorPoint({ 0, 1 });
+    titleMenu->ignoreAnchorPointForPosition(false);
 
-    auto menu = cocos2d::CCMenu::create();
-    menu->setPosition(0, 0);
-    menu->setAnchorPoint({ 0, 0 });
-    menu->ignoreAnchorPointForPosition(true);
-    menu->setContentSize({ ScrollViewWidth - 5.f, 200.f });
-
-    for (auto& emoji : category.emojis) {
-        auto sprite = createEmojiSprite(emoji);
-        if (!sprite) {
-            geode::log::warn("Emoji {} not found", emoji);
-            continue;
-        }
-
-        sprite = encloseInContainer(sprite, 18.f * getUIScaleF());
-
-        auto item = FeedbackButton::create(
-            sprite, [this, emoji] {
-                auto cursorPos = m_originalField->m_textField->m_uCursorPos;
-                std::string originalText = m_originalField->getString();
-                std::string_view sw = originalText;
-
-                // check if text limit is reached
-                if (sw.size() + emoji.size() >= 190) {
-                    return geode::Notification::create(
-                        "Text limit reached",
-                        geode::NotificationIcon::Warning
-                    )->show();
-                }
-
-                // insert emoji at cursor position
-                if (cursorPos >= 0) {
-                    m_originalField->setString(fmt::format(
-                        "{}{}{}",
-                        sw.substr(0, cursorPos),
-                        emoji, sw.substr(cursorPos)
-                    ));
-
-                    auto newCursor = cursorPos + emoji.size();
-                    m_originalField->m_textField->m_uCursorPos = newCursor;
-                    m_originalField->updateBlinkLabelToChar(newCursor);
-                } else {
-                    // or append to the end
-                    m_originalField->setString(originalText + emoji);
-                }
-
-                incrementEmojiUsage(emoji);
-            }, [this, emoji] {
-                toggleFavoriteEmoji(emoji);
-                this->recreateGroups();
-                this->updateScrollLayer();
-            }
-        );
-        item->setID(emoji);
-        menu->addChild(item);
-    }
+    // buttons are only created once the grid scrolls into view
+    auto menu = EmojiGrid::create(
+        category.emojis, ScrollViewWidth - 5.f, pool,
+        owner ? static_cast<EmojiGridDelegate*>(owner) : &s_prewarmDelegate
+    );
 
     auto isCollapsed = geode::Mod::get()->getSaveContainer()["collapsed"][category.name].asBool().unwrapOr(false);
     auto collapseBtnSprite = cocos2d::CCSprite::createWithSpriteFrameName("edit_downBtn_001.png");
@@ -504,35 +668,17 @@ cocos2d::CCNode* EmojiPicker::appendGroup(EmojiCategory const& category) const {
     );
 
     auto menuContainer = CCNode::create();
-    menu->setLayout(
-        geode::RowLayout::create()
-            ->setAutoScale(false)
-            ->setAxisAlignment(geode::AxisAlignment::Start)
-            ->setCrossAxisAlignment(geode::AxisAlignment::Even)
-            ->setCrossAxisLineAlignment(geode::AxisAlignment::Even)
-            ->setGrowCrossAxis(true)
-    );
-
-    auto menuHeight = menu->getContentHeight();
-    float extraHeight = menuHeight > 18.f ? 5.f : 9.f;
-    auto bgHeight = menuHeight + extraHeight;
+    menuContainer->setAnchorPoint({ 0, 1 });
+    auto bgHeight = getGridHeight(menu);
     menuContainer->setContentSize({ ScrollViewWidth, bgHeight });
-    menu->setPosition(2.5f, extraHeight * 0.5f);
+    menu->setPosition(2.5f, (bgHeight - menu->getContentHeight()) * 0.5f);
 
     auto bg = createBackground(ScrollViewWidth, bgHeight);
     bg->setPosition(menuContainer->getContentSize() * 0.5f);
     bg->setID("emoji-category-bg"_spr);
 
-    auto collapseBtn = geode::cocos::CCMenuItemExt::createSpriteExtra(
-        collapseBtnNode, [this, menu, bg, menuContainer, collapseBtnSprite, bgHeight, category = category.name](auto) {
-            bool visible = !menu->isVisible();
-            geode::Mod::get()->getSaveContainer()["collapsed"][category] = !visible;
-            menu->setVisible(visible);
-            bg->setVisible(visible);
-            collapseBtnSprite->runAction(cocos2d::CCRotateTo::create(0.1f, visible ? 0.f : -90.f));
-            menuContainer->setContentHeight(visible ? bgHeight : 0.f );
-            this->updateScrollLayer();
-        }
+    auto collapseBtn = CCMenuItemSpriteExtra::create(
+        collapseBtnNode, owner, menu_selector(EmojiPicker::onToggleSection)
     );
     collapseBtn->m_scaleMultiplier = 1.0f;
     collapseBtn->setPosition(collapseBtn->getContentSize() * 0.5f);
@@ -549,28 +695,242 @@ cocos2d::CCNode* EmojiPicker::appendGroup(EmojiCategory const& category) const {
         menuContainer->setContentHeight(0.f);
     }
 
-    contentLayer->addChild(titleMenu);
-    contentLayer->addChild(menuContainer);
+    return {
+        .name = category.name,
+        .header = titleMenu,
+        .body = menuContainer,
+        .background = bg,
+        .arrow = collapseBtnSprite,
+        .toggle = collapseBtn,
+        .grid = menu,
+        .collapsed = isCollapsed
+    };
+}
+
+float EmojiPicker::getGridHeight(EmojiGrid* grid) {
+    auto menuHeight = grid->getContentHeight();
+    return menuHeight + (menuHeight > 18.f ? 5.f : 9.f);
+}
+
+void EmojiPicker::setSectionCollapsed(size_t index, bool collapsed) {
+    auto& section = m_sections[index];
+    section.collapsed = collapsed;
+    geode::Mod::get()->getSaveContainer()["collapsed"][section.name] = collapsed;
+
+    section.grid->setVisible(!collapsed);
+    section.background->setVisible(!collapsed);
+    section.arrow->runAction(cocos2d::CCRotateTo::create(0.1f, collapsed ? -90.f : 0.f));
+    section.body->setContentHeight(collapsed ? 0.f : getGridHeight(section.grid));
+
+    // only the sections below need to move
+    this->layoutSections(index);
+    this->updateScrollLayer();
+}
+
+void EmojiPicker::onToggleSection(CCObject* sender) {
+    for (size_t i = 0; i < m_sections.size(); ++i) {
+        if (m_sections[i].toggle == sender) {
+            return this->setSectionCollapsed(i, !m_sections[i].collapsed);
+        }
+    }
+}
+
+void EmojiPicker::updateSection(size_t index, std::vector<std::string> emojis) {
+    auto& section = m_sections[index];
+    auto grid = section.grid;
+    auto const& current = grid->getEmojis();
+
+    // find the first difference
+    size_t prefix = 0;
+    auto common = std::min(current.size(), emojis.size());
+    while (prefix < common && current[prefix] == emojis[prefix]) ++prefix;
+    if (prefix == current.size() && prefix == emojis.size()) return;
+
+    // whether the section is above the visible area, before anything moves
+    auto contentLayer = m_scrollLayer->m_contentLayer;
+    auto viewTop = contentLayer->getContentHeight() + contentLayer->getPositionY() - m_scrollLayer->getContentHeight();
+    auto sectionBottom = section.offset + section.header->getContentHeight() + section.body->getContentHeight();
+    bool aboveView = sectionBottom <= viewTop;
+
+    // single insertions and removals only shift the cells after them
+    if (emojis.size() == current.size() + 1 && std::equal(current.begin() + prefix, current.end(), emojis.begin() + prefix + 1)) {
+        grid->insertEmoji(prefix, std::move(emojis[prefix]));
+    } else if (emojis.size() + 1 == current.size() && std::equal(emojis.begin() + prefix, emojis.end(), current.begin() + prefix + 1)) {
+        grid->removeEmoji(prefix);
+    } else {
+        grid->setEmojis(std::move(emojis));
+    }
+
+    // move the sections below if the height changed
+    auto oldHeight = m_sectionsHeight;
+    if (this->resizeSectionBody(section)) {
+        this->layoutSections(index);
+        this->updateScrollLayer();
+
+        // keep the same emojis in view when the change happened above them
+        if (aboveView) {
+            m_scrollLayer->scrollLayer(m_sectionsHeight - oldHeight);
+        }
+    }
+
+    this->updateVisibleCells();
+}
+
+bool EmojiPicker::resizeSectionBody(Section& section) {
+    auto grid = section.grid;
+    auto bgHeight = getGridHeight(grid);
+    grid->setPosition(2.5f, (bgHeight - grid->getContentHeight()) * 0.5f);
+    section.background->setContentSize({ ScrollViewWidth * 2.f, bgHeight * 2.f });
+    section.background->setPosition({ ScrollViewWidth * 0.5f, bgHeight * 0.5f });
+
+    if (section.collapsed || section.body->getContentHeight() == bgHeight) {
+        return false;
+    }
+    section.body->setContentHeight(bgHeight);
+    return true;
+}
+
+void EmojiPicker::setSearchQuery(std::string_view query) {
+    PROFILE_SCOPE(EmojiSearch);
+
+    m_searchQuery = normalizeEmojiQuery(query);
+    this->applySearch();
+    this->layoutSections(0);
+    this->updateScrollLayer();
+    m_scrollLayer->scrollToTop();
+    this->updateVisibleCells();
+}
+
+void EmojiPicker::applySearch() {
+    bool searching = !m_searchQuery.empty();
+    for (size_t i = 0; i < m_sections.size(); ++i) {
+        m_sections[i].hidden = (i == SearchResultsSection) != searching;
+    }
+
+    if (searching) {
+        auto& results = m_sections[SearchResultsSection];
+        results.grid->setEmojis(searchEmojis(m_searchQuery));
+        this->resizeSectionBody(results);
+    }
+}
+
+std::optional<size_t> EmojiPicker::findSection(std::string_view name) const {
+    for (size_t i = 0; i < m_sections.size(); ++i) {
+        if (m_sections[i].name == name) return i;
+    }
+    return std::nullopt;
+}
+
+void EmojiPicker::layoutSections(size_t first) {
+    float offset = first < m_sections.size() ? m_sections[first].offset : 0.f;
+    for (size_t i = first; i < m_sections.size(); ++i) {
+        auto& section = m_sections[i];
+        section.offset = offset;
+        section.header->setVisible(!section.hidden);
+        section.body->setVisible(!section.hidden);
+        if (section.hidden) continue;
+
+        section.header->setPosition(0.f, -offset);
+        offset += section.header->getContentHeight() + ScrollGap;
+        section.body->setPosition(0.f, -offset);
+        offset += section.body->getContentHeight() + ScrollGap;
+    }
+    m_sectionsHeight = offset;
+}
+
+void EmojiPicker::updateScrollLayer() {
+    auto contentLayer = m_scrollLayer->m_contentLayer;
+    auto oldHeight = contentLayer->getContentHeight();
+
+    contentLayer->setContentHeight(std::max(m_sectionsHeight, GridViewHeight));
+    m_sectionStack->setPositionY(contentLayer->getContentHeight());
 
-    return titleMenu;
+    // keep the top of the view in place
+    m_scrollLayer->scrollLayer(oldHeight - contentLayer->getContentHeight());
+    if (m_scrollbar) {
+        m_scrollbar->setTarget(m_scrollLayer);
+    }
 }
 
-void EmojiPicker::updateScrollLayer() const {
-    auto oldHeight = m_scrollLayer->m_contentLayer->getContentHeight();
+void EmojiPicker::updateVisibleCells() {
+    auto contentLayer = m_scrollLayer->m_contentLayer;
+    m_lastScrollPosition = contentLayer->getPosition();
+    m_lastContentHeight = contentLayer->getContentHeight();
+
+    // visible area of the scroll layer, in world space
+    auto viewBottom = m_scrollLayer->convertToWorldSpace({ 0.f, 0.f });
+    auto viewTop = m_scrollLayer->convertToWorldSpace({ 0.f, m_scrollLayer->getContentHeight() });
 
-    // calculate required height
-    float height = -ScrollGap;
-    for (auto child : geode::cocos::CCArrayExt<CCNode*>(m_scrollLayer->m_contentLayer->getChildren())) {
-        height += child->getContentSize().height + ScrollGap;
+    for (auto& section : m_sections) {
+        auto grid = section.grid;
+        if (section.collapsed || section.hidden) {
+            grid->releaseCells();
+            continue;
+        }
+
+        grid->updateVisibleCells(
+            grid->convertToNodeSpace(viewBottom).y,
+            grid->convertToNodeSpace(viewTop).y
+        );
     }
+}
 
-    m_scrollLayer->m_contentLayer->setContentHeight(std::max(height, ScrollViewHeight));
+void EmojiPicker::update(float dt) {
+    Popup::update(dt);
 
-    auto diff = -m_scrollLayer->m_contentLayer->getContentHeight() + oldHeight;
+    auto contentLayer = m_scrollLayer->m_contentLayer;
+    if (contentLayer->getPosition() != m_lastScrollPosition || contentLayer->getContentHeight() != m_lastContentHeight) {
+        this->updateVisibleCells();
+    }
+}
 
-    m_scrollLayer->m_contentLayer->updateLayout();
-    m_scrollLayer->scrollLayer(diff);
-    m_scrollbar->setTarget(m_scrollLayer);
+cocos2d::CCNode* EmojiPicker::createEmojiNode(std::string_view emoji) {
+    return createEmojiSprite(emoji);
+}
+
+void EmojiPicker::onEmojiClicked(std::string const& emoji) {
+    auto cursorPos = m_originalField->m_textField->m_uCursorPos;
+    std::string originalText = m_originalField->getString();
+    std::string_view sw = originalText;
+
+    // check if text limit is reached
+    if (sw.size() + emoji.size() >= 190) {
+        return geode::Notification::create(
+            "Text limit reached",
+            geode::NotificationIcon::Warning
+        )->show();
+    }
+
+    // insert emoji at cursor position
+    if (cursorPos >= 0) {
+        m_originalField->setString(fmt::format(
+            "{}{}{}",
+            sw.substr(0, cursorPos),
+            emoji, sw.substr(cursorPos)
+        ));
+
+        auto newCursor = cursorPos + emoji.size();
+        m_originalField->m_textField->m_uCursorPos = newCursor;
+        m_originalField->updateBlinkLabelToChar(newCursor);
+    } else {
+        // or append to the end
+        m_originalField->setString(originalText + emoji);
+    }
+
+    incrementEmojiUsage(emoji);
+}
+
+void EmojiPicker::onEmojiHeld(std::string const& emoji) {
+    toggleFavoriteEmoji(emoji);
+
+    auto favorites = getFavoriteEmojis();
+    auto section = findSection("Favorites");
+    if (section && !favorites.empty()) {
+        this->updateSection(*section, std::move(favorites));
+    } else {
+        // the section (and its sidebar button) appears or disappears
+        this->recreateGroups();
+    }
 }
 
 void EmojiPicker::beginClose() {
@@ -592,6 +952,12 @@ void EmojiPicker::beginClose() {
     ));
 }
 
+void EmojiPicker::onClose(CCObject* sender) {
+    UsageStats::get().flush();
+    this->storeCachedSections();
+    Popup::onClose(sender);
+}
+
 bool EmojiPicker::ccTouchBegan(cocos2d::CCTouch* touch, cocos2d::CCEvent* event) {
     if (!Popup::ccTouchBegan(touch, event)) {
         return false;
@@ -2,27 +2,75 @@
 #include <cocos2d.h>
 #include <Geode/ui/Popup.hpp>
 #include <Geode/ui/Scrollbar.hpp>
+#include <Geode/ui/TextInput.hpp>
+#include "emoji-grid.hpp"
 #include "label.hpp"
 #include "scroll-layer.hpp"
 #include "utils.hpp"
+#include <memory>
+#include <optional>
 
-class EmojiPicker final : public geode::Popup<CCTextInputNode*> {
+class EmojiPicker final : public geode::Popup<CCTextInputNode*>, public EmojiGridDelegate {
 protected:
+    struct Section {
+        std::string name;
+        CCNode* header = nullptr;     // title with the collapse button
+        CCNode* body = nullptr;       // background and grid, zero height when collapsed
+        CCNode* background = nullptr;
+        CCNode* arrow = nullptr;      // collapse indicator
+        CCMenuItemSpriteExtra* toggle = nullptr; // collapse button, retargeted when the section is reused
+        EmojiGrid* grid = nullptr;
+        float offset = 0.f;           // distance from the top of the content layer to the header
+        bool collapsed = false;
+        bool hidden = false;          // filtered out by the search
+    };
+
+    /// @brief Sections of the static categories, kept detached between pickers so they're only built once.
+    struct SectionCache;
+
     CCTextInputNode* m_originalField = nullptr;
     ScrollLayer* m_scrollLayer = nullptr;
     ScrollLayer* m_sidebarPanel = nullptr;
     geode::Scrollbar* m_scrollbar = nullptr;
     CCLayer* m_inputLayer = nullptr;
+    geode::TextInput* m_searchInput = nullptr;
+    std::string m_searchQuery;                 // normalized, empty when not searching
+    std::shared_ptr<EmojiCellPool> m_cellPool; // buttons shared by all grids, outlives the picker if cached
+    CCNode* m_sectionStack = nullptr;          // parent of all sections, pinned to the top of the content layer
+    std::vector<Section> m_sections;           // sections in display order
+    size_t m_firstStaticSection = 0;           // sections from here on belong to the static categories
+    float m_sectionsHeight = 0.f;              // total height of all sections
+    cocos2d::CCPoint m_lastScrollPosition;     // content layer position on the last visibility update
+    float m_lastContentHeight = 0.f;           // content layer height on the last visibility update
     bool m_isClosing = false;
 
 public:
     static EmojiPicker* create(CCTextInputNode* input);
 
+    /// @brief Create a sprite for an emoji placeholder (e.g. ":cruel:"), or nullptr if it doesn't exist.
+    static CCNode* createEmojiSprite(std::string_view emoji);
+    /// @brief Whether createEmojiSprite would succeed for the placeholder, without creating a node.
+    static bool hasEmojiSprite(std::string_view emoji);
+    static CCNode* encloseInContainer(CCNode* node, float size);
+
+    /// @brief Drop the cached category sections. A picker that is currently open keeps its own.
+    static void purgeSectionCache();
+    /// @brief Build the next static section into the cache, ahead of the first opening.
+    /// Returns false once all of them are built, or if the cache is disabled or in use.
+    static bool prewarmNextSection();
+    /// @brief Create the cells the cached sections show when the picker opens.
+    static void prewarmVisibleCells();
+
 protected:
+    ~EmojiPicker() override;
     bool setup(CCTextInputNode* input) override;
 
-    static CCNode* createEmojiSprite(std::string_view emoji);
-    static CCNode* encloseInContainer(CCNode* node, float size);
+    static SectionCache& getSectionCache();
+    static bool isSectionCacheEnabled();
+    /// @brief Move the cached static sections into this picker. Returns false if they have to be built.
+    bool adoptCachedSections();
+    /// @brief Detach the static sections and hand them back to the cache, if this picker owns it.
+    void storeCachedSections();
 
     static std::vector<EmojiCategory> const& getEmojiCategories();
     static std::vector<std::string> getFrequentlyUsedEmojis();
@@ -31,13 +79,42 @@ protected:
     static void incrementEmojiUsage(std::string const& emoji);
     static void toggleFavoriteEmoji(std::string const& emoji);
 
-    void recreateGroups() const;
+    void recreateGroups();
+
+    /// @brief Build the header and body of a section without adding them anywhere.
+    /// Without an owner, buttons do nothing until the section is adopted by a picker.
+    static Section createSection(EmojiCategory const& category, EmojiCellPool* pool, EmojiPicker* owner);
+    CCNode* appendGroup(EmojiCategory const& category);
+    static float getGridHeight(EmojiGrid* grid);
+    void setSectionCollapsed(size_t index, bool collapsed);
+    void onToggleSection(CCObject* sender);
+    /// @brief Replace the emojis of a section in place, moving only the sections below it.
+    void updateSection(size_t index, std::vector<std::string> emojis);
+    /// @brief Fit the section body to its grid. Returns true if the section height changed.
+    static bool resizeSectionBody(Section& section);
+    [[nodiscard]] std::optional<size_t> findSection(std::string_view name) const;
+
+    /// @brief Show only the emojis matching the query, or all categories if it's empty.
+    void setSearchQuery(std::string_view query);
+    /// @brief Fill the search results and hide the other sections, without laying them out.
+    void applySearch();
+
+    /// @brief Position sections starting from the given index, the ones above are left untouched.
+    void layoutSections(size_t first);
+    /// @brief Resize the content layer to fit all sections, keeping the scroll position.
+    void updateScrollLayer();
+
+    /// @brief Create buttons for the emojis inside the scroll view, and recycle the ones that left it.
+    void updateVisibleCells();
+    void update(float dt) override;
 
-    CCNode* appendGroup(EmojiCategory const& category) const;
-    void updateScrollLayer() const;
+    CCNode* createEmojiNode(std::string_view emoji) override;
+    void onEmojiClicked(std::string const& emoji) override;
+    void onEmojiHeld(std::string const& emoji) override;
 
     void beginClose();
     void endClose() { this->onClose(nullptr); }
+    void onClose(CCObject* sender) override;
 
     bool ccTouchBegan(cocos2d::CCTouch* touch, cocos2d::CCEvent* event) override;
 };
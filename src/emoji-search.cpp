@@ -0,0 +1,103 @@
+#include "emoji-search.hpp"
+#include "emojis.hpp"
+#include <algorithm>
+#include <unordered_set>
+
+static constexpr auto NameIndex = [] {
+    std::array<EmojiNameEntry, EmojiReplacements.size()> index{};
+    for (size_t i = 0; i < EmojiReplacements.size(); ++i) {
+        auto& [placeholder, emoji] = EmojiReplacements[i];
+        index[i] = { placeholder.substr(1, placeholder.size() - 2), placeholder, emoji };
+    }
+    std::ranges::sort(index, {}, &EmojiNameEntry::name);
+    return index;
+}();
+
+static_assert(std::ranges::all_of(EmojiReplacements, [](auto const& entry) {
+    return entry.name.size() > 2 && entry.name.front() == ':' && entry.name.back() == ':';
+}), "Emoji placeholders must be surrounded by colons");
+
+EmojiNameRange getEmojiNameIndex() {
+    return NameIndex;
+}
+
+EmojiNameRange findEmojisByPrefix(std::string_view prefix, EmojiNameRange range) {
+    auto first = std::ranges::lower_bound(range, prefix, {}, &EmojiNameEntry::name);
+    auto last = std::ranges::upper_bound(first, range.end(), prefix, [](std::string_view prefix, std::string_view name) {
+        // names starting with the prefix compare equal to it
+        return prefix < name.substr(0, prefix.size());
+    }, &EmojiNameEntry::name);
+    return { first, last };
+}
+
+EmojiNameEntry const* findEmoji(std::string_view placeholder) {
+    if (placeholder.size() < 3 || placeholder.front() != ':' || placeholder.back() != ':') {
+        return nullptr;
+    }
+
+    auto name = placeholder.substr(1, placeholder.size() - 2);
+    auto it = std::ranges::lower_bound(NameIndex, name, {}, &EmojiNameEntry::name);
+    if (it == NameIndex.end() || it->name != name) {
+        return nullptr;
+    }
+    return &*it;
+}
+
+std::string normalizeEmojiQuery(std::string_view query) {
+    while (!query.empty() && query.front() == ':') query.remove_prefix(1);
+    while (!query.empty() && query.back() == ':') query.remove_suffix(1);
+
+    std::string result(query);
+    for (auto& c : result) {
+        if (c >= 'A' && c <= 'Z') c += 'a' - 'A';
+    }
+    return result;
+}
+
+static constexpr bool isNameChar(char c) {
+    return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || (c >= '0' && c <= '9') || c == '_';
+}
+
+std::optional<ShortcodeQuery> findShortcodeAtCursor(std::string_view text, size_t cursor) {
+    cursor = std::min(cursor, text.size());
+
+    auto start = cursor;
+    while (start > 0 && isNameChar(text[start - 1])) --start;
+    if (start == 0 || text[start - 1] != ':') return std::nullopt;
+
+    auto colon = start - 1;
+    if (colon > 0 && (isNameChar(text[colon - 1]) || text[colon - 1] == ':')) return std::nullopt;
+
+    return ShortcodeQuery{ colon, text.substr(start, cursor - start) };
+}
+
+std::vector<std::string> searchEmojis(std::string_view query, size_t limit) {
+    auto needle = normalizeEmojiQuery(query);
+    if (needle.empty()) return {};
+
+    std::vector<std::string> results;
+    std::unordered_set<std::string_view> seen;
+
+    auto add = [&](EmojiNameEntry const& entry) {
+        if (seen.insert(entry.emoji).second) {
+            results.emplace_back(entry.placeholder);
+        }
+        return results.size() < limit;
+    };
+
+    auto prefixMatches = findEmojisByPrefix(needle);
+    for (auto& entry : prefixMatches) {
+        if (!add(entry)) return results;
+    }
+
+    for (auto& entry : NameIndex) {
+        if (entry.name.size() > needle.size()
+            && !entry.name.starts_with(needle)
+            && entry.name.find(needle) != std::string_view::npos
+            && !add(entry)) {
+            return results;
+        }
+    }
+
+    return results;
+}
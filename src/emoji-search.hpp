@@ -0,0 +1,47 @@
+#pragma once
+#include <cstddef>
+#include <limits>
+#include <optional>
+#include <span>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// Name lookup for emoji placeholders, backed by a sorted index built at compile time
+// from EmojiReplacements (hidden aliases included). Free of cocos2d and Geode like text.hpp.
+
+struct EmojiNameEntry {
+    std::string_view name;        // name without colons, e.g. "cruel"
+    std::string_view placeholder; // e.g. ":cruel:"
+    std::string_view emoji;       // UTF-8 sequence the placeholder is replaced with
+};
+
+using EmojiNameRange = std::span<EmojiNameEntry const>;
+
+/// @brief All emoji names, sorted.
+EmojiNameRange getEmojiNameIndex();
+
+/// @brief Find all names starting with the prefix.
+/// Passing the range found for a shorter prefix only searches inside it,
+/// so typing can narrow down the previous result instead of starting over.
+EmojiNameRange findEmojisByPrefix(std::string_view prefix, EmojiNameRange range = getEmojiNameIndex());
+
+/// @brief Find an emoji by its placeholder (e.g. ":cruel:").
+EmojiNameEntry const* findEmoji(std::string_view placeholder);
+
+/// @brief Lowercase the query and remove the colons around it.
+std::string normalizeEmojiQuery(std::string_view query);
+
+/// @brief Partially typed ":name" right before the cursor.
+struct ShortcodeQuery {
+    size_t start;          // position of the colon
+    std::string_view name; // characters typed after the colon
+};
+
+/// @brief Find the shortcode being typed before the cursor. The colon must be at the start of
+/// the text or after a character that can't be part of a name (so "12:30" is not a shortcode).
+std::optional<ShortcodeQuery> findShortcodeAtCursor(std::string_view text, size_t cursor);
+
+/// @brief Get placeholders matching the query: prefix matches first (alphabetically), then substring matches.
+/// Aliases of an emoji that is already in the results are skipped.
+std::vector<std::string> searchEmojis(std::string_view query, size_t limit = std::numeric_limits<size_t>::max());
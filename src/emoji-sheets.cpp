@@ -0,0 +1,116 @@
+#include "emoji-sheets.hpp"
+#include "animated-sprite.hpp"
+#include "emojis.hpp"
+#include <Geode/loader/Log.hpp>
+#include <Geode/utils/cocos.hpp>
+#include <fmt/format.h>
+#include <array>
+
+const Label::CustomNodeMap CustomNodeSheet = []() {
+    Label::CustomNodeMap nodes;
+    for (auto& entry : AnimatedEmojis) {
+        nodes.emplace(entry.sequence, [entry](std::u32string_view, uint32_t&) -> cocos2d::CCNode* {
+            // sprite resources are treated as UHD by Geode, so 4 pixels make a point
+            cocos2d::CCSize frameSize = { entry.width / 4.f, entry.height / 4.f };
+            return FrameAnimation::create(entry.prefix, entry.frames, 1.f / entry.fps, frameSize);
+        });
+    }
+    return nodes;
+}();
+
+static std::string getPagePath(EmojiPage const& page, std::string_view extension) {
+    return fmt::format("{}/{}.{}", GEODE_MOD_ID, page.sheet, extension);
+}
+
+// labels and sprites currently using each page, pages without users can be unloaded by releaseUnusedEmojiPages
+static std::array<size_t, EmojiPages.size()> s_pageUsers{};
+
+cocos2d::CCTexture2D* loadEmojiPage(size_t page) {
+    if (page >= EmojiPages.size()) {
+        return nullptr;
+    }
+
+    auto& info = EmojiPages[page];
+    auto frameCache = cocos2d::CCSpriteFrameCache::get();
+
+    auto frame = frameCache->spriteFrameByName(info.probe);
+    if (!frame) {
+        frameCache->addSpriteFramesWithFile(getPagePath(info, "plist").c_str());
+        frame = frameCache->spriteFrameByName(info.probe);
+        if (!frame) {
+            geode::log::error("Failed to load emoji page {}", info.sheet);
+            return nullptr;
+        }
+    }
+
+    return frame->getTexture();
+}
+
+cocos2d::CCTexture2D* retainEmojiPage(size_t page) {
+    auto texture = loadEmojiPage(page);
+    if (texture) {
+        s_pageUsers[page]++;
+    }
+    return texture;
+}
+
+static void unloadEmojiPage(size_t page) {
+    auto& info = EmojiPages[page];
+    auto frame = cocos2d::CCSpriteFrameCache::get()->spriteFrameByName(info.probe);
+    if (!frame) return;
+
+    geode::Ref texture = frame->getTexture();
+
+    // cached metrics are holding references to the frames
+    Label::purgeEmojiMetrics(texture);
+    cocos2d::CCSpriteFrameCache::get()->removeSpriteFramesFromFile(getPagePath(info, "plist").c_str());
+    cocos2d::CCTextureCache::get()->removeTexture(texture);
+}
+
+void releaseEmojiPage(size_t page) {
+    if (page >= EmojiPages.size() || s_pageUsers[page] == 0) {
+        geode::log::warn("Emoji page {} was released more times than it was retained", page);
+        return;
+    }
+
+    // an unused page stays loaded, a comment list that is rebuilt retains it again right away,
+    // releaseUnusedEmojiPages frees it once memory is needed
+    s_pageUsers[page]--;
+}
+
+size_t getEmojiPageCount() {
+    return EmojiPages.size();
+}
+
+void releaseUnusedEmojiPages() {
+    for (size_t page = 0; page < EmojiPages.size(); page++) {
+        if (s_pageUsers[page] == 0) {
+            unloadEmojiPage(page);
+        }
+    }
+}
+
+/// @brief Emoji sprite outside of a label, keeps its page loaded for as long as it exists.
+class PageSprite final : public cocos2d::CCSprite {
+public:
+    explicit PageSprite(size_t page) : m_page(page) {}
+    ~PageSprite() override { releaseEmojiPage(m_page); }
+
+private:
+    size_t m_page;
+};
+
+cocos2d::CCSprite* createEmojiPageSprite(EmojiFrame const& emoji) {
+    if (!retainEmojiPage(emoji.page)) {
+        return nullptr;
+    }
+
+    // the page is released by the destructor, even if init fails
+    auto ret = new PageSprite(emoji.page);
+    if (ret->initWithSpriteFrameName(emoji.name)) {
+        ret->autorelease();
+        return ret;
+    }
+    delete ret;
+    return nullptr;
+}
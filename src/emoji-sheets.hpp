@@ -0,0 +1,30 @@
+#pragma once
+#include <cocos2d.h>
+#include <cstddef>
+#include "label.hpp"
+
+/// @brief Custom nodes for animated emojis, built from the AnimatedEmojis table.
+/// Never modified, so lookups are safe from any thread (creating the nodes is not).
+extern const Label::CustomNodeMap CustomNodeSheet;
+
+/// @brief Get the atlas texture of an emoji page, loading its sprite frames if they are not in the cache.
+/// Does not count as a use of the page, so it may be unloaded again once its last user releases it.
+cocos2d::CCTexture2D* loadEmojiPage(size_t page);
+
+/// @brief Load an emoji page and count the caller as one of its users, until releaseEmojiPage.
+/// Can be passed to Label::enableEmojis as a page loader, with releaseEmojiPage as the releaser.
+cocos2d::CCTexture2D* retainEmojiPage(size_t page);
+
+/// @brief Stop using an emoji page. A page without users stays loaded until releaseUnusedEmojiPages.
+void releaseEmojiPage(size_t page);
+
+/// @brief Amount of emoji pages, valid indices for loadEmojiPage.
+size_t getEmojiPageCount();
+
+/// @brief Unload all emoji pages that have no users, including ones loaded without retainEmojiPage.
+/// Pages will be loaded again by loadEmojiPage once needed.
+void releaseUnusedEmojiPages();
+
+/// @brief Create a sprite for an emoji frame that keeps its page retained while the sprite exists.
+/// Returns nullptr if the page or frame could not be loaded.
+cocos2d::CCSprite* createEmojiPageSprite(EmojiFrame const& emoji);
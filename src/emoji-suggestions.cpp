@@ -0,0 +1,151 @@
+#include "emoji-suggestions.hpp"
+#include "emoji-picker.hpp"
+#include "usage-stats.hpp"
+#include <Geode/ui/Notification.hpp>
+#include <Geode/utils/cocos.hpp>
+#include <algorithm>
+#include <limits>
+#include <unordered_set>
+
+EmojiSuggestions* EmojiSuggestions::create(CCTextInputNode* input) {
+    auto ret = new EmojiSuggestions();
+    if (ret->init(input)) {
+        ret->autorelease();
+        return ret;
+    }
+    delete ret;
+    return nullptr;
+}
+
+bool EmojiSuggestions::init(CCTextInputNode* input) {
+    if (!CCMenu::init()) {
+        return false;
+    }
+
+    m_input = input;
+
+    auto background = cocos2d::extension::CCScale9Sprite::create("square02_001.png");
+    background->setOpacity(100);
+    background->setScale(0.5f);
+    background->setZOrder(-1);
+    m_background = background;
+    this->addChild(m_background);
+
+    this->setContentSize({ 0.f, ButtonSize + ButtonGap });
+    this->setAnchorPoint({ 0.5f, 0.5f });
+    this->ignoreAnchorPointForPosition(false);
+    this->setVisible(false);
+    this->scheduleUpdate();
+
+    return true;
+}
+
+void EmojiSuggestions::update(float) {
+    std::string text = m_input->getString();
+    int cursor = m_input->m_textField->m_uCursorPos;
+    if (cursor == m_lastCursor && text == m_lastText) {
+        return;
+    }
+
+    auto position = cursor < 0 ? text.size() : static_cast<size_t>(cursor);
+    auto shortcode = findShortcodeAtCursor(text, position);
+    m_queryStart = shortcode ? shortcode->start : 0;
+    this->setQuery(shortcode ? normalizeEmojiQuery(shortcode->name) : "");
+
+    m_lastText = std::move(text);
+    m_lastCursor = cursor;
+}
+
+void EmojiSuggestions::setQuery(std::string_view query) {
+    if (query == m_query) {
+        return;
+    }
+
+    if (query.size() < MinQueryLength) {
+        m_query.clear();
+        m_matches = {};
+    } else {
+        // typing more characters can only narrow down the previous matches
+        auto narrowing = !m_query.empty() && query.starts_with(m_query);
+        m_matches = findEmojisByPrefix(query, narrowing ? m_matches : getEmojiNameIndex());
+        m_query = query;
+    }
+
+    this->rebuild();
+}
+
+void EmojiSuggestions::rebuild() {
+    // most used first, then alphabetically
+    auto& stats = UsageStats::get();
+    std::vector<std::pair<size_t, EmojiNameEntry const*>> ranked;
+    ranked.reserve(m_matches.size());
+    for (auto& entry : m_matches) {
+        auto rank = stats.getRank(std::string(entry.placeholder));
+        ranked.emplace_back(rank.value_or(std::numeric_limits<size_t>::max()), &entry);
+    }
+    std::ranges::stable_sort(ranked, {}, &std::pair<size_t, EmojiNameEntry const*>::first);
+
+    std::vector<std::string> suggestions;
+    std::unordered_set<std::string_view> seen;
+    for (auto& [rank, entry] : ranked) {
+        if (suggestions.size() >= MaxSuggestions) break;
+        if (seen.insert(entry->emoji).second) {
+            suggestions.emplace_back(entry->placeholder);
+        }
+    }
+
+    if (suggestions == m_suggestions) {
+        return;
+    }
+    m_suggestions = std::move(suggestions);
+
+    // recreate the buttons, there are only a few of them
+    for (auto child : geode::cocos::CCArrayExt<CCNode*>(this->getChildren())) {
+        if (child != m_background) child->removeFromParent();
+    }
+
+    auto width = m_suggestions.size() * (ButtonSize + ButtonGap) + ButtonGap;
+    this->setContentWidth(width);
+    m_background->setContentSize({ width * 2.f, (ButtonSize + ButtonGap) * 2.f });
+    m_background->setPosition(this->getContentSize() * 0.5f);
+
+    for (size_t i = 0; i < m_suggestions.size(); ++i) {
+        auto sprite = EmojiPicker::createEmojiSprite(m_suggestions[i]);
+        if (!sprite) continue;
+        sprite = EmojiPicker::encloseInContainer(sprite, ButtonSize);
+
+        auto btn = geode::cocos::CCMenuItemExt::createSpriteExtra(
+            sprite, [this, placeholder = m_suggestions[i]](auto) {
+                this->complete(placeholder);
+            }
+        );
+        btn->setID(m_suggestions[i]);
+        btn->setPosition(ButtonGap + i * (ButtonSize + ButtonGap) + ButtonSize * 0.5f, this->getContentHeight() * 0.5f);
+        this->addChild(btn);
+    }
+
+    this->setVisible(!m_suggestions.empty());
+}
+
+void EmojiSuggestions::complete(std::string const& placeholder) {
+    std::string text = m_input->getString();
+    int cursor = m_input->m_textField->m_uCursorPos;
+    auto position = cursor < 0 ? text.size() : std::min<size_t>(cursor, text.size());
+
+    auto typed = position - m_queryStart;
+    if (text.size() - typed + placeholder.size() >= 190) {
+        return geode::Notification::create(
+            "Text limit reached",
+            geode::NotificationIcon::Warning
+        )->show();
+    }
+
+    m_input->setString(text.substr(0, m_queryStart) + placeholder + text.substr(position));
+    if (cursor >= 0) {
+        auto newCursor = m_queryStart + placeholder.size();
+        m_input->m_textField->m_uCursorPos = newCursor;
+        m_input->updateBlinkLabelToChar(newCursor);
+    }
+
+    UsageStats::get().increment(placeholder);
+}
@@ -0,0 +1,40 @@
+#pragma once
+#include <cocos2d.h>
+#include <Geode/binding/CCTextInputNode.hpp>
+#include <string>
+#include <vector>
+#include "emoji-search.hpp"
+
+/// @brief Strip of emoji suggestions for a ":name" being typed in a text input.
+/// Polls the input every frame, but only searches when the typed name changes,
+/// narrowing the previous prefix match while characters are being added.
+class EmojiSuggestions final : public cocos2d::CCMenu {
+public:
+    static constexpr size_t MaxSuggestions = 6;
+    static constexpr size_t MinQueryLength = 2;
+    static constexpr float ButtonSize = 20.f;
+    static constexpr float ButtonGap = 4.f;
+
+    static EmojiSuggestions* create(CCTextInputNode* input);
+
+protected:
+    bool init(CCTextInputNode* input);
+    void update(float dt) override;
+
+    /// @brief Update the matches for the name typed after the colon.
+    void setQuery(std::string_view query);
+    /// @brief Pick the most used matches and recreate the buttons.
+    void rebuild();
+    /// @brief Replace the typed shortcode with the full placeholder.
+    void complete(std::string const& placeholder);
+
+protected:
+    CCTextInputNode* m_input = nullptr;
+    cocos2d::CCNode* m_background = nullptr;
+    std::string m_lastText;                 // input text on the last check
+    int m_lastCursor = -2;                  // cursor position on the last check
+    std::string m_query;                    // typed name, empty if there is no shortcode
+    size_t m_queryStart = 0;                // position of the colon in the text
+    EmojiNameRange m_matches;               // names starting with m_query
+    std::vector<std::string> m_suggestions; // placeholders currently shown
+};
@@ -1,10 +1,9 @@
 #pragma once
-#include "label.hpp"
 #include "utils.hpp"
 
 constexpr auto EmojiGroups = std::tuple<
     EmojiGroup<
-        "Geometry Dash", ":easy:",
+        "Geometry Dash", ":easy:", "EmojiSheetGD",
         // Level difficulties
         Unimoji<"na", 0x1c000>,          Unimoji<"auto", 0x1c001>,
         Unimoji<"easy", 0x1c002>,        Unimoji<"normal", 0x1c003>,
@@ -33,7 +32,7 @@ constexpr auto EmojiGroups = std::tuple<
         UnimojiUtf8<"like", "👍", U"👍">,  UnimojiUtf8<"dislike", "👎", U"👎">
     >,
     EmojiGroup<
-        "Twemoji", ":sunglasses:",
+        "Twemoji", ":sunglasses:", "EmojiSheetTwemoji",
         // People
         UnimojiUtf8<"face_holding_back_tears", "🥹", U"🥹">,    UnimojiUtf8<"slight_smile", "🙂", U"🙂">,
         UnimojiUtf8<"wink", "😉", U"😉">,                       UnimojiUtf8<"heart_eyes", "😍", U"😍">,
@@ -94,7 +93,7 @@ constexpr auto EmojiGroups = std::tuple<
         UnimojiUtf8<"tada", "🎉", U"🎉", true>
     >,
     EmojiGroup<
-        "Legacy Set", ":ned:",
+        "Legacy Set", ":ned:", "EmojiSheetLegacy",
         Unimoji<"amongus", 0x1c030>,         Unimoji<"amogus", 0x1c031>,
         Unimoji<"bruh", 0x1c032>,            Unimoji<"carlos", 0x1c033>,
         Unimoji<"clueless", 0x1c034>,        Unimoji<"despair", 0x1c035>,
@@ -134,7 +133,7 @@ constexpr auto EmojiGroups = std::tuple<
         Unimoji<"deltaruneexplosion", 0x1c60b, 17, 17>
     >,
     EmojiGroup<
-        "Custom Emojis", ":eyesShock:",
+        "Custom Emojis", ":eyesShock:", "EmojiSheetCustom",
         Unimoji<"eyesShock", 0x1c100>,       Unimoji<"trollskull", 0x1c101>,
         Unimoji<"laughAtThisUser", 0x1c102>, Unimoji<"ballCat", 0x1c103>,
         Unimoji<"bigBrain", 0x1c104>,        Unimoji<"breeble", 0x1c105>,
@@ -149,7 +148,7 @@ constexpr auto EmojiGroups = std::tuple<
         Unimoji<"trolleyzoom", 0x1c60c, 178, 25>, Unimoji<"fishspin", 0x1c60d, 144, 28>
     >,
     EmojiGroup<
-        "Samsung Emojis", ":grinning:",
+        "Samsung Emojis", ":grinning:", "EmojiSheetSamsung",
         Unimoji<"grinning", 0x1c300>,      Unimoji<"smiley", 0x1c301>,
         Unimoji<"yaay", 0x1c302>,          Unimoji<"cheeky", 0x1c303>,
         Unimoji<"slight_smile2", 0x1c304>, Unimoji<"blushing", 0x1c305>,
@@ -163,7 +162,7 @@ constexpr auto EmojiGroups = std::tuple<
         Unimoji<"skull2", 0x1c314>
     >,
     EmojiGroup<
-        "Cube Emotes (By @cyanflower)", ":cubehappy:",
+        "Cube Emotes (By @cyanflower)", ":cubehappy:", "EmojiSheetCube",
         Unimoji<"cubeballin", 0x1c071>,   Unimoji<"cubeconfused", 0x1c072>,
         Unimoji<"cubecool", 0x1c073>,     Unimoji<"cubehappy", 0x1c074>,
         Unimoji<"cubeletsgo", 0x1c075>,   Unimoji<"cubepog", 0x1c076>,
@@ -178,7 +177,7 @@ constexpr auto EmojiGroups = std::tuple<
         Unimoji<"cubehyperthink", 0x1c60a, 6, 20>
     >,
     EmojiGroup<
-        "Cat Emotes (C# Discord Server)", ":catgun:",
+        "Cat Emotes (C# Discord Server)", ":catgun:", "EmojiSheetCat",
         Unimoji<"catbless", 0x1c090>,      Unimoji<"catcash", 0x1c091>,
         Unimoji<"catcomf", 0x1c092>,       Unimoji<"catcool", 0x1c093>,
         Unimoji<"catcop", 0x1c094>,        Unimoji<"catcorn", 0x1c095>,
@@ -201,7 +200,7 @@ constexpr auto EmojiGroups = std::tuple<
         Unimoji<"catthinking", 0x1c0b6>
     >,
     EmojiGroup<
-        "Player Icons", ":default:",
+        "Player Icons", ":default:", "EmojiSheetPlayers",
         Unimoji<"default", 0x1c0c0>,       Unimoji<"sdslayer", 0x1c0c1>,
         Unimoji<"evw", 0x1c0c2>,           Unimoji<"tride", 0x1c0c3>,
         Unimoji<"colon", 0x1c0c4>,         Unimoji<"robtop", 0x1c0c5>,
@@ -213,12 +212,31 @@ constexpr auto EmojiGroups = std::tuple<
 
 constexpr auto EmojiReplacements = CombineReplacements(EmojiGroups);
 
-inline static Label::EmojiMap EmojiSheet = []() {
+constexpr auto EmojiPages = CombinePages(EmojiGroups);
+
+/// @brief Replace all ":name:" placeholders in the text with their emojis.
+inline std::string replaceEmojis(std::string_view text) {
+    auto result = std::string(text);
+    for (auto& [name, emoji] : EmojiReplacements) {
+        findAndReplace(result, name, emoji);
+    }
+    return result;
+}
+
+/// @brief All regular emojis, by sequence. Built once and never modified, so it can be read from any thread.
+inline const EmojiMap EmojiSheet = []() {
     constexpr auto combined = CombineRegulars(EmojiGroups);
-    return Label::EmojiMap(combined.begin(), combined.end());
+    return EmojiMap(combined.begin(), combined.end());
 }();
 
-inline static Label::CustomNodeMap CustomNodeSheet = []() {
-    constexpr auto combined = CombineAnimated(EmojiGroups);
-    return Label::CustomNodeMap(combined.begin(), combined.end());
-}();
+/// @brief Frame size of every animation in pixels, all frames of an animation have the same size.
+/// Known ahead of time, so that an animation can take up its space before its frames are loaded.
+constexpr FrameSize AnimationFrameSizes[] = {
+    { "bonk", 72, 72 },                { "colonthreecat", 48, 48 },       { "cubedance", 72, 62 },
+    { "cubehyperthink", 72, 64 },      { "cubespeen", 72, 64 },           { "deltaruneexplosion", 51, 72 },
+    { "fishspin", 48, 48 },            { "hype", 72, 72 },                { "ned_explosion", 65, 72 },
+    { "partying", 72, 72 },            { "petmaurice", 72, 72 },          { "polarbear", 72, 72 },
+    { "shiggy", 64, 64 },              { "trolleyzoom", 48, 48 }
+};
+
+constexpr auto AnimatedEmojis = WithFrameSizes(CombineAnimated(EmojiGroups), AnimationFrameSizes);
@@ -1,35 +1,163 @@
 #include "label.hpp"
+#include "profiler.hpp"
 #include <Geode/loader/Log.hpp>
 #include <Geode/utils/general.hpp>
-#include <iostream>
-#include <simdutf.h>
-#include <sstream>
+#include <algorithm>
+#include <atomic>
+#include <map>
+#include <memory>
+#include <mutex>
+
+/// @brief Loaded font, along with the memory its metrics take.
+struct FontCacheEntry {
+    BMFontConfiguration::Handle font;
+    size_t bytes = 0;
+};
+
+/// @brief Immutable set of loaded fonts. Readers (e.g. Label::measure on worker threads) take the current
+/// snapshot without locking, writers copy it under the writer lock and publish the copy.
+using FontSnapshot = std::unordered_map<std::string, FontCacheEntry>;
+using FontSnapshotPtr = std::shared_ptr<const FontSnapshot>;
+
+#ifdef __cpp_lib_atomic_shared_ptr
+static std::atomic<FontSnapshotPtr>& getFontSnapshot() {
+    static std::atomic<FontSnapshotPtr> s_fontSnapshot = std::make_shared<const FontSnapshot>();
+    return s_fontSnapshot;
+}
+
+static FontSnapshotPtr loadFontSnapshot() {
+    return getFontSnapshot().load(std::memory_order_acquire);
+}
 
-std::unordered_map<std::string, BMFontConfiguration>& getFontConfigs() {
-    static std::unordered_map<std::string, BMFontConfiguration> s_fontConfigs;
-    return s_fontConfigs;
+static void publishFontSnapshot(FontSnapshotPtr snapshot) {
+    getFontSnapshot().store(std::move(snapshot), std::memory_order_release);
+}
+#else
+static FontSnapshotPtr& getFontSnapshot() {
+    static FontSnapshotPtr s_fontSnapshot = std::make_shared<const FontSnapshot>();
+    return s_fontSnapshot;
 }
 
-BMFontConfiguration* BMFontConfiguration::create(std::string_view fntFile) {
-    auto& s_fontConfigs = getFontConfigs();
+// fallback for standard libraries without std::atomic<std::shared_ptr> (deprecated since C++20)
+static FontSnapshotPtr loadFontSnapshot() {
+    return std::atomic_load_explicit(&getFontSnapshot(), std::memory_order_acquire);
+}
+
+static void publishFontSnapshot(FontSnapshotPtr snapshot) {
+    std::atomic_store_explicit(&getFontSnapshot(), std::move(snapshot), std::memory_order_release);
+}
+#endif
 
+// only one thread at a time can load or purge fonts
+static std::mutex s_fontWriterMutex;
+
+/// @brief Fallback indices of every font set used by a label, keyed by the fonts and their scales.
+/// Labels own the indices, an index is alive only while a label holding all of its fonts is.
+using FontSetKey = std::vector<std::pair<const BMFontConfiguration*, std::optional<float>>>;
+static std::map<FontSetKey, std::weak_ptr<const FontFallbackIndex>>& getFallbackIndices() {
+    static std::map<FontSetKey, std::weak_ptr<const FontFallbackIndex>> s_fallbackIndices;
+    return s_fallbackIndices;
+}
+
+/// @brief Get the fallback index of a font set, building it on first use. The fonts must have fallbacks.
+static std::shared_ptr<const FontFallbackIndex> getFallbackIndex(std::span<const LayoutFont> fonts) {
+    FontSetKey key;
+    key.reserve(fonts.size());
+    for (auto& font : fonts) {
+        key.emplace_back(font.config, font.scale);
+    }
+
+    // an expired index is rebuilt, even if its key matches, since the fonts might have been freed and reallocated
+    auto& cached = getFallbackIndices()[std::move(key)];
+    auto index = cached.lock();
+    if (!index) {
+        index = std::make_shared<const FontFallbackIndex>(fonts);
+        cached = index;
+    }
+    return index;
+}
+
+/// @brief Forget the indices no label uses anymore, their keys may point to freed fonts.
+static void purgeExpiredFallbackIndices() {
+    std::erase_if(getFallbackIndices(), [](auto const& entry) { return entry.second.expired(); });
+}
+
+BMFontConfiguration::Handle BMFontConfiguration::find(std::string_view fntFile) {
+    auto snapshot = loadFontSnapshot();
+    auto it = snapshot->find(std::string(fntFile));
+    return it == snapshot->end() ? nullptr : it->second.font;
+}
+
+BMFontConfiguration::Handle BMFontConfiguration::create(std::string_view fntFile) {
     // check if the font config is already loaded
+    if (auto font = find(fntFile)) {
+        return font;
+    }
+
     std::string fntFileStr(fntFile);
-    auto it = s_fontConfigs.find(fntFileStr);
-    if (it != s_fontConfigs.end()) {
-        return &it->second;
+
+    std::lock_guard lock(s_fontWriterMutex);
+
+    // another writer might have loaded it in the meantime
+    auto snapshot = loadFontSnapshot();
+    if (auto it = snapshot->find(fntFileStr); it != snapshot->end()) {
+        return it->second.font;
     }
 
     // load the font config
-    BMFontConfiguration config{};
-    if (!config.initWithFNTfile(fntFile)) {
+    auto config = std::make_shared<BMFontConfiguration>();
+    if (!config->initWithFNTfile(fntFile)) {
         return nullptr;
     }
-    return &s_fontConfigs.emplace(fntFileStr, std::move(config)).first->second;
+
+    auto bytes = config->getMemoryUsage() + fntFileStr.capacity();
+    auto next = std::make_shared<FontSnapshot>(*snapshot);
+    next->emplace(std::move(fntFileStr), FontCacheEntry{config, bytes});
+    publishFontSnapshot(std::move(next));
+    return config;
 }
 
 void BMFontConfiguration::purgeCachedData() {
-    getFontConfigs().clear();
+    {
+        std::lock_guard lock(s_fontWriterMutex);
+        publishFontSnapshot(std::make_shared<const FontSnapshot>());
+    }
+    purgeExpiredFallbackIndices();
+}
+
+size_t BMFontConfiguration::purgeUnusedFonts() {
+    size_t freed = 0;
+    {
+        std::lock_guard lock(s_fontWriterMutex);
+        auto snapshot = loadFontSnapshot();
+        auto next = std::make_shared<FontSnapshot>();
+        for (auto& [name, entry] : *snapshot) {
+            // the current snapshot holds the only handle
+            if (entry.font.use_count() == 1) {
+                freed += entry.bytes;
+            } else {
+                next->emplace(name, entry);
+            }
+        }
+        if (freed > 0) {
+            publishFontSnapshot(std::move(next));
+        }
+    }
+    purgeExpiredFallbackIndices();
+    return freed;
+}
+
+BMFontConfiguration::CacheStats BMFontConfiguration::getCacheStats() {
+    auto snapshot = loadFontSnapshot();
+
+    CacheStats stats;
+    for (auto& [_, entry] : *snapshot) {
+        ++stats.fonts;
+        // the snapshot holds one handle, older snapshots still being read hold more
+        stats.fontsInUse += entry.font.use_count() > 1;
+        stats.bytes += entry.bytes;
+    }
+    return stats;
 }
 
 cocos2d::CCString* createWithContentsOfFile(const char* pszFileName)
@@ -65,275 +193,110 @@ bool BMFontConfiguration::initWithFNTfile(std::string_view fntFile) {
     }
     #endif
 
-    return initWithContents(contents, fntFileStr);
-}
-
-#define WRAP_PARSE(expr) if (auto res = (expr); res.isErr()) { geode::log::error("{}", res.unwrapErr()); return false; }
-
-bool BMFontConfiguration::initWithContents(std::string const& contents, std::string const& fntFile) {
-    std::istringstream stream(contents);
-    std::string line;
-
-    while (std::getline(stream, line)) {
-        if (line.empty()) {
-            continue;
-        }
-
-        std::istringstream lineStream(line);
-        std::string type;
-        lineStream >> type;
-
-        if (type == "info") {
-            WRAP_PARSE(parseInfoArguments(lineStream));
-        } else if (type == "common") {
-            WRAP_PARSE(parseCommonArguments(lineStream));
-        } else if (type == "page") {
-            WRAP_PARSE(parseImageFileName(lineStream, fntFile));
-        } else if (type == "char") {
-            WRAP_PARSE(parseCharacterDefinition(lineStream));
-        } else if (type == "kerning") {
-            WRAP_PARSE(parseKerningEntry(lineStream));
-        }
-    }
-
-    return true;
-}
-
-template <class T>
-T fastParse(std::string_view str) {
-    return geode::utils::numFromString<T>(str).unwrapOrDefault();
-}
-
-geode::Result<> BMFontConfiguration::parseInfoArguments(std::istringstream& line) {
-    std::string keypair;
-
-    while (line >> keypair) {
-        auto eqPos = keypair.find('=');
-        if (eqPos == std::string::npos) {
-            continue;
-        }
-
-        auto key = keypair.substr(0, eqPos);
-        auto value = keypair.substr(eqPos + 1);
-
-        if (key == "padding") {
-            std::istringstream paddingStream(value);
-            char comma;
-            paddingStream >> m_padding.left >> comma >> m_padding.top >> comma >> m_padding.right >> comma >> m_padding.bottom;
-        }
+    if (auto err = initWithContents(contents)) {
+        geode::log::error("{}", *err);
+        return false;
     }
 
-    return geode::Ok();
-}
-
-geode::Result<> BMFontConfiguration::parseImageFileName(std::istringstream& line, std::string const& fntFile) {
-    std::string keypair;
-
-    while (line >> keypair) {
-        auto eqPos = keypair.find('=');
-        if (eqPos == std::string::npos) {
-            continue;
-        }
-
-        auto key = keypair.substr(0, eqPos);
-        auto value = keypair.substr(eqPos + 1);
-
-        if (key == "file") {
-            auto relPath = value.substr(1, value.size() - 2); // remove quotes
-            m_atlasName = cocos2d::CCFileUtils::get()->fullPathFromRelativeFile(
-                relPath.c_str(), fntFile.c_str()
-            );
-        }
+    if (m_atlasSize > cocos2d::CCConfiguration::sharedConfiguration()->m_nMaxTextureSize) {
+        geode::log::error("Font size exceeds max texture size");
+        return false;
     }
 
-    if (m_atlasName.empty()) {
-        return geode::Err("Failed to parse image file name");
-    }
+    m_atlasName = cocos2d::CCFileUtils::get()->fullPathFromRelativeFile(
+        m_atlasFile.c_str(), fntFileStr.c_str()
+    );
 
-    return geode::Ok();
+    return true;
 }
 
-geode::Result<> BMFontConfiguration::parseCommonArguments(std::istringstream& line) {
-    std::string keypair;
-
-    while (line >> keypair) {
-        auto eqPos = keypair.find('=');
-        if (eqPos == std::string::npos) {
-            continue;
-        }
+struct EmojiMetricsKey {
+    const char* frameName;
+    float commonHeight;
+    float scaleFactor;
 
-        auto key = keypair.substr(0, eqPos);
-        auto value = keypair.substr(eqPos + 1);
+    bool operator==(EmojiMetricsKey const& other) const = default;
+};
 
-        if (key == "lineHeight") {
-            m_commonHeight = fastParse<float>(value);
-        } else if (key == "scaleW" || key == "scaleH") {
-            if (fastParse<int>(value) > cocos2d::CCConfiguration::sharedConfiguration()->m_nMaxTextureSize) {
-                return geode::Err("Font size exceeds max texture size");
-            }
-        } else if (key == "pages") {
-            if (fastParse<int>(value) != 1) {
-                return geode::Err("Font must have exactly one page");
-            }
-        }
+template <>
+struct std::hash<EmojiMetricsKey> {
+    size_t operator()(EmojiMetricsKey const& key) const noexcept {
+        auto hash = std::hash<const char*>()(key.frameName);
+        hash ^= std::hash<float>()(key.commonHeight) + 0x9e3779b9 + (hash << 6) + (hash >> 2);
+        hash ^= std::hash<float>()(key.scaleFactor) + 0x9e3779b9 + (hash << 6) + (hash >> 2);
+        return hash;
     }
+};
 
-    return geode::Ok();
+static std::unordered_map<EmojiMetricsKey, Label::EmojiMetrics>& getEmojiMetricsCache() {
+    static std::unordered_map<EmojiMetricsKey, Label::EmojiMetrics> s_emojiMetrics;
+    return s_emojiMetrics;
 }
 
-geode::Result<> BMFontConfiguration::parseCharacterDefinition(std::istringstream& line) {
-    BMFontDef def;
-    std::string keypair;
+const Label::EmojiMetrics* Label::getEmojiMetrics(EmojiFrame const& emoji, float commonHeight, float scaleFactor) {
+    auto& cache = getEmojiMetricsCache();
 
-    while (line >> keypair) {
-        auto eqPos = keypair.find('=');
-        if (eqPos == std::string::npos) {
-            continue;
-        }
-
-        auto key = keypair.substr(0, eqPos);
-        auto value = keypair.substr(eqPos + 1);
-
-        if (key == "id") {
-            def.charID = fastParse<uint32_t>(value);
-        } else if (key == "x") {
-            def.rect.origin.x = fastParse<int>(value);
-        } else if (key == "y") {
-            def.rect.origin.y = fastParse<int>(value);
-        } else if (key == "width") {
-            def.rect.size.width = fastParse<int>(value);
-        } else if (key == "height") {
-            def.rect.size.height = fastParse<int>(value);
-        } else if (key == "xoffset") {
-            def.xOffset = fastParse<float>(value);
-        } else if (key == "yoffset") {
-            def.yOffset = fastParse<float>(value);
-        } else if (key == "xadvance") {
-            def.xAdvance = fastParse<float>(value);
-        }
+    // frame names are compile-time strings, so the pointer is enough to identify an emoji
+    EmojiMetricsKey key{emoji.name, commonHeight, scaleFactor};
+    if (auto it = cache.find(key); it != cache.end()) {
+        return &it->second;
     }
 
-    m_fontDefDictionary[def.charID] = def;
-    // m_characterSet.insert(def.charID);
-
-    return geode::Ok();
-}
-
-geode::Result<> BMFontConfiguration::parseKerningEntry(std::istringstream& line) {
-    std::string keypair;
-
-    while (line >> keypair) {
-        auto eqPos = keypair.find('=');
-        if (eqPos == std::string::npos) {
-            continue;
-        }
-
-        auto key = keypair.substr(0, eqPos);
-        auto value = keypair.substr(eqPos + 1);
-
-        if (key == "first") {
-            auto first = fastParse<uint32_t>(value);
-            line >> keypair;
-            eqPos = keypair.find('=');
-            if (eqPos == std::string::npos) {
-                return geode::Err("Failed to parse kerning entry first");
-            }
-
-            auto second = fastParse<uint32_t>(keypair.substr(eqPos + 1));
-            line >> keypair;
-            eqPos = keypair.find('=');
-            if (eqPos == std::string::npos) {
-                return geode::Err("Failed to parse kerning entry second");
-            }
-
-            auto amount = fastParse<float>(keypair.substr(eqPos + 1));
-            m_kerningDictionary[{first, second}] = amount;
-        }
+    auto frame = cocos2d::CCSpriteFrameCache::get()->spriteFrameByName(emoji.name);
+    if (!frame) {
+        return nullptr;
     }
 
-    return geode::Ok();
-}
-
-#undef WRAP_PARSE
-
-std::u32string utf8_to_utf32(std::string_view text) {
-    size_t length = simdutf::utf32_length_from_utf8(text.data(), text.size());
-    std::u32string result(length, 0);
-    (void) simdutf::convert_utf8_to_utf32(text.data(), text.size(), result.data());
-    return result;
-}
-
-std::string utf32_to_utf8(std::u32string_view text) {
-    size_t length = simdutf::utf8_length_from_utf32(text.data(), text.size());
-    std::string result(length, 0);
-    (void) simdutf::convert_utf32_to_utf8(text.data(), text.size(), result.data());
-    return result;
-}
+    // rescale to fit font height
+    auto size = frame->getOriginalSize();
+    auto scale = commonHeight / (size.height * scaleFactor);
 
-constexpr bool isRegionalIndicator(char32_t c) {
-    return c >= 0x1F1E6 && c <= 0x1F1FF;
+    return &cache.emplace(key, EmojiMetrics{
+        frame, size.width * scaleFactor * scale, scale
+    }).first->second;
 }
 
-constexpr static bool isEmoji(char32_t c) {
-    return (c >= 0x1F300 && c <= 0x1F6FF)    // Emoticons, transport, weather
-           || (c >= 0x2600 && c <= 0x27BF)   // Miscellaneous Symbols and Dingbats
-           || (c >= 0x2000 && c <= 0x23FF)   // General Punctuation, Super/subscripts, Diacritical marks, etc.
-           || (c >= 0x2B50 && c <= 0x2B55)   // Star emojis
-           || (c >= 0x1F900 && c <= 0x1F9FF) // Supplemental Symbols and Pictographs
-           || (c >= 0x1F700 && c <= 0x1F7FF) // Alchemical Symbols
-           || (c >= 0x1FA00 && c <= 0x1FAFF) // Symbols and Pictographs Extended-A
-           || (c >= 0x1F000 && c <= 0x1F02F) // Mahjong, Domino
-           || (c >= 0xE0020 && c <= 0xE007F) // Tags for flags
-           || (c >= 0x1C000 && c <= 0x1CFFF) // Custom range for special emojis
-           || c == 0x20E3;                   // Combining enclosing keycap
+void Label::purgeEmojiMetrics() {
+    getEmojiMetricsCache().clear();
 }
 
-constexpr static bool isSkinToneModifier(char32_t c) {
-    return c >= 0x1F3FB && c <= 0x1F3FF;
-}
-
-constexpr static bool isZeroWidthJoiner(char32_t c) {
-    return c == 0x200D;
+void Label::purgeEmojiMetrics(cocos2d::CCTexture2D* texture) {
+    std::erase_if(getEmojiMetricsCache(), [texture](auto const& entry) {
+        return entry.second.frame->getTexture() == texture;
+    });
 }
 
-constexpr static bool isVariationSelector(char32_t c) {
-    return c >= 0xFE00 && c <= 0xFE0F;
+Label::Measurement Label::measure(std::string_view text, std::string_view font) {
+    return measure(text, font, MeasureOptions{});
 }
 
-constexpr static bool isDigit(char32_t c) {
-    return c <= 0x0039 && c >= 0x0030;
-}
+Label::Measurement Label::measure(std::string_view text, std::string_view font, MeasureOptions const& options) {
+    Measurement result;
 
-constexpr static bool shouldParseDigitRegionalIndicator(std::u32string_view text) {
-    return isDigit(text[0]) && text.size() > 2 && text[2] == 0x20E3 && isVariationSelector(text[1]);
-}
-
-// Custom math stuff
+    // loading a font reads files and isn't thread safe, so only a font that is already loaded is used
+    auto config = BMFontConfiguration::find(font);
+    if (!config || text.empty()) {
+        return result;
+    }
 
-struct Vector {
-    union {
-        struct { float x, y; };
-        struct { float width, height; };
+    LayoutFont fonts[] = {{config.get()}};
+    LayoutOptions layoutOptions{
+        .scaleFactor = cocos2d::CCDirector::get()->getContentScaleFactor(),
+        .extraKerning = options.extraKerning,
+        .extraLineSpacing = options.extraLineSpacing,
+        .wrap = options.wrap,
+        .wrapWidth = options.wrapWidth / options.scale,
+        .breakWords = options.breakWords
     };
-    constexpr Vector() noexcept : x(0.f), y(0.f) {}
-    constexpr Vector(float x_, float y_) noexcept : x(x_), y(y_) {}
-    constexpr operator cocos2d::CCPoint() const { return cocos2d::CCPoint { x, y }; }
-    constexpr operator cocos2d::CCSize() const { return cocos2d::CCSize { x, y }; }
-};
+    // no emoji map or delegate, so nothing but the font is looked up
+    LayoutContext context{fonts};
 
-struct Rect {
-    Vector origin;
-    Vector size;
-    constexpr Rect() noexcept = default;
-    constexpr Rect(float x, float y, float w, float h) noexcept : origin(x, y), size(w, h) {}
-    constexpr operator cocos2d::CCRect() const { return cocos2d::CCRect { origin, size }; }
-    constexpr void setRect(float x, float y, float width, float height) {
-        origin.x = x;
-        origin.y = y;
-        size.width = width;
-        size.height = height;
-    }
-};
+    thread_local TextLayout s_layout;
+    auto size = measureText(utf8_to_utf32(text), context, layoutOptions, s_layout, &result.lineWidths);
+    result.width = size.width;
+    result.height = size.height;
+    return result;
+}
 
 Label* Label::create(std::string_view text, std::string_view font) {
     auto ret = new Label();
@@ -422,6 +385,8 @@ void Label::setString(std::string_view text) {
         return;
     }
 
+    PROFILE_SCOPE(SetString);
+
     m_text = text;
     m_unicodeText = std::move(utf8_to_utf32(text));
     //      m_useChunks = false; // reset chunks
@@ -439,8 +404,9 @@ void Label::setFont(std::string_view font) {
         return;
     }
 
-    m_fontConfig = newConfig;
+    m_fontConfig = std::move(newConfig);
     m_font = font;
+    this->updateFallbackIndex();
 
     m_mainBatch->setTexture(
         cocos2d::CCTextureCache::get()->addImage(
@@ -469,20 +435,54 @@ void Label::addFont(std::string_view font, std::optional<float> scale) {
     batch->setID(fmt::format("font-batch-{}", m_fontBatches.size()));
     m_fontBatches.push_back({newConfig, CachedBatch(batch), scale});
     this->addChild(batch, 0, m_fontBatches.size());
+    this->updateFallbackIndex();
 }
 
-void Label::enableEmojis(std::string_view sheetFileName, const EmojiMap* frameNames) {
-    if (m_spriteSheetBatch) {
-        auto texture = cocos2d::CCTextureCache::get()->addImage(sheetFileName.data(), false);
-        m_spriteSheetBatch->setTexture(texture);
-    } else {
-        m_spriteSheetBatch = cocos2d::CCSpriteBatchNode::create(sheetFileName.data());
-        m_spriteSheetBatch->setID("emoji-sheet");
-        this->addChild(m_spriteSheetBatch.node, 0, -1);
+void Label::enableEmojis(EmojiPageLoader pageLoader, EmojiPageReleaser pageReleaser, const EmojiMap* frameNames) {
+    if (m_emojiPageLoader != pageLoader) {
+        // pages from the previous loader can't be reused
+        this->releaseEmojiBatches();
     }
+    m_emojiPageLoader = pageLoader;
+    m_emojiPageReleaser = pageReleaser;
     m_emojiMap = frameNames;
 }
 
+void Label::releaseEmojiBatches() {
+    for (size_t page = 0; page < m_emojiBatches.size(); page++) {
+        auto& batch = m_emojiBatches[page];
+        if (!batch) continue;
+
+        batch->removeFromParent();
+        if (m_emojiPageReleaser) m_emojiPageReleaser(page);
+    }
+    m_emojiBatches.clear();
+}
+
+Label::CachedBatch* Label::getEmojiBatch(size_t page) {
+    if (page >= m_emojiBatches.size()) {
+        m_emojiBatches.resize(page + 1);
+    }
+
+    auto& batch = m_emojiBatches[page];
+    if (!batch) {
+        auto texture = m_emojiPageLoader(page);
+        if (!texture) { return nullptr; }
+
+        batch = cocos2d::CCSpriteBatchNode::createWithTexture(texture);
+        batch->setID(fmt::format("emoji-sheet-{}", page));
+        this->addChild(batch.node, 0, -1 - static_cast<int>(page));
+    }
+
+    return &batch;
+}
+
+bool Label::isEmojiSprite(cocos2d::CCSprite* sprite) const {
+    return std::ranges::any_of(m_emojiBatches, [sprite](CachedBatch const& batch) {
+        return batch.node && sprite->m_pParent == batch.node;
+    });
+}
+
 void Label::enableCustomNodes(const CustomNodeMap* nodes) {
     m_customNodeMap = nodes;
 }
@@ -540,13 +540,23 @@ void Label::limitLabelWidth(float width, float defaultScale, float minScale) {
     this->setScale(scale);
 }
 
-float Label::kerningAmountForChars(uint32_t first, uint32_t second, const BMFontConfiguration* config) {
-    auto& kerningDict = config->getKerningDictionary();
-    auto it = kerningDict.find({first, second});
-    if (it == kerningDict.end()) {
-        return 0;
+float Label::fitToBox(std::string_view text, float width, float height, float minScale) {
+    if (m_text != text) {
+        m_text = text;
+        m_unicodeText = utf8_to_utf32(text);
     }
-    return it->second;
+    return this->fitToBox(width, height, minScale);
+}
+
+float Label::fitToBox(float width, float height, float minScale) {
+    PROFILE_SCOPE(SetString);
+
+    m_useWrap = true;
+    m_wrapWidth = width;
+
+    FitBox fit{width, height, minScale};
+    this->layoutChars(&fit);
+    return this->getScale();
 }
 
 void Label::hideAllChars() {
@@ -561,465 +571,70 @@ void Label::hideAllChars() {
     m_customNodes.clear();
 }
 
-void Label::updateAlignment() const {
-    if ((m_alignment == BMFontAlignment::Left || m_lines.size() < 2) && !m_useWrap) {
+void Label::updateFallbackIndex() {
+    if (m_fontBatches.empty()) {
+        m_fallbackIndex = nullptr;
         return;
     }
 
-    auto contentWidth = this->m_obContentSize.width;
-
-    for (auto& line : m_lines) {
-        if (line.empty()) {
-            continue;
-        }
-
-        float offset = 0;
-        if (m_alignment == BMFontAlignment::Right) {
-            auto last = line.back();
-            offset = contentWidth - last->m_obPosition.x - last->m_obContentSize.width * last->m_fScaleX * 0.5f;
-        } else if (m_alignment == BMFontAlignment::Center) {
-            auto first = line.front();
-            auto last = line.back();
-            auto endPos = last->m_obPosition.x + last->m_obContentSize.width * last->m_fScaleX * 0.5f;
-            auto startPos = first->m_obPosition.x - first->m_obContentSize.width * first->m_fScaleX * 0.5f;
-            offset = (contentWidth - endPos + startPos) * 0.5f;
-        } else if (m_alignment == BMFontAlignment::Justify) {
-            // TODO: justify
-        }
-
-        if (offset == 0.f) {
-            continue;
-        }
-
-        for (auto& charSprite : line) {
-            charSprite->setPositionX(charSprite->m_obPosition.x + offset);
-        }
-    }
-}
-
-float Label::getWordWidth(std::vector<cocos2d::CCSprite*> const& word) {
-    if (word.empty()) {
-        return 0.f;
-    }
-
-    auto first = word.front();
-    auto last = word.back();
-
-    auto firstPos = first->getPositionX();
-    auto lastPos = last->getPositionX();
-    auto firstSize = first->getScaledContentWidth();
-    auto lastSize = last->getScaledContentWidth();
-
-    return lastPos - firstPos + lastSize * 0.5f + firstSize * 0.5f;
+    m_fallbackIndex = getFallbackIndex(this->getLayoutFonts());
 }
 
-void Label::updateCharsWrapped() {
-    auto stringLen = m_unicodeText.size();
-    auto textSV = std::u32string_view(m_unicodeText);
-
-    std::vector<std::vector<std::u32string_view>> lines;
-    size_t wordStart = 0;
-
-    // split the text into lines and words
-    std::vector<std::u32string_view> words;
-    for (size_t i = 0; i < stringLen; ++i) {
-        if (textSV[i] == ' ') {
-            words.push_back(textSV.substr(wordStart, i - wordStart));
-            wordStart = i + 1;
-            continue;
-        }
-
-        // check if we should break the word
-        if (textSV[i] == '\n') {
-            words.push_back(textSV.substr(wordStart, i - wordStart));
-            wordStart = i + 1;
-            lines.push_back(std::move(words));
-            words.clear();
-        } else if (i == stringLen - 1) {
-            words.push_back(textSV.substr(wordStart, i - wordStart + 1));
-            lines.push_back(std::move(words));
-            words.clear();
-        } else if (m_breakWords > 0 && i - wordStart >= m_breakWords) {
-            words.push_back(textSV.substr(wordStart, i - wordStart));
-            wordStart = i;
-        }
-    }
-    if (!words.empty()) {
-        lines.push_back(std::move(words));
-    }
-
-    m_lines.clear();
-    m_sprites.clear();
-    m_sprites.reserve(stringLen);
-
-    auto& mainCharset = m_fontConfig->getFontDefDictionary();
-    auto commonHeight = m_fontConfig->getCommonHeight();
-    auto lineHeight = commonHeight + m_extraLineSpacing;
-
-    BMFontConfiguration* currentConfig = m_fontConfig;
-    const BMFontDef* fontDef = nullptr;
-    char32_t prevChar;
-    float kerningAmount = 0;
-    float nextX = 0;
-    float longestLine = 0;
-    auto scaleFactor = cocos2d::CCDirector::get()->m_fContentScaleFactor;
-
-    auto& spaceDef = mainCharset.at(' ');
-    auto spaceWidth = (m_extraKerning + spaceDef.xAdvance) / scaleFactor;
-
-    std::vector<size_t> indices(m_fontBatches.size() + 1, 0);
-    size_t emojiIndex = 0;
-
-    struct Word {
-        std::vector<CCNode*> sprites;
-        float xOffset = 0.f;
-        float fromX = 0;
-        float toX = 0;
-    };
-
-    std::vector<std::vector<Word>> spriteLines;
-    std::vector<Word> currentSpriteLine;
-    Word currentSpriteWord;
-
-    // iterate over all words and get the width of each word
-    for (auto& line : lines) {
-        // build the words
-        for (auto& word : line) {
-            auto wordLen = word.size();
-            prevChar = -1;
-
-            currentSpriteWord.fromX = nextX;
-
-            // iterate over all characters in the word
-            for (uint32_t k = 0; k < wordLen; ++k) {
-                float nextY = 0;
-                auto c = word[k];
-                if (c == ' ') {
-                    continue;
-                }
-
-                // find the font definition for the character
-                float scale = 1.f;
-                size_t fontIndex = 0;
-                auto* currentBatch = &m_mainBatch;
-
-                if (m_spriteSheetBatch && shouldParseDigitRegionalIndicator(word.substr(k))) {
-                    checkForEmoji(
-                        word, k, scaleFactor,
-                        nextX, nextY, commonHeight,
-                        longestLine, currentSpriteWord.sprites,
-                        emojiIndex
-                    );
-                    continue;
-                }
-
-                fontDef = getFontDefForChar(c, m_fontConfig, scale, fontIndex, currentBatch, currentConfig);
-                if (!fontDef) {
-                    checkForEmoji(
-                        word, k, scaleFactor,
-                        nextX, nextY, commonHeight,
-                        longestLine, currentSpriteWord.sprites,
-                        emojiIndex
-                    );
-                    continue;
-                }
-
-                if (k == 0) {
-                    currentSpriteWord.xOffset = (m_extraKerning + fontDef->xOffset * scale) / scaleFactor;
-                }
-
-                auto& index = indices[fontIndex];
-                kerningAmount = kerningAmountForChars(prevChar, c, currentConfig) * scale;
-
-                Rect rect = {
-                    fontDef->rect.origin.x / scaleFactor, fontDef->rect.origin.y / scaleFactor,
-                    fontDef->rect.size.width / scaleFactor, fontDef->rect.size.height / scaleFactor
-                };
-
-                // Re-using existing sprites for performance reasons
-                auto fontChar = getSpriteForChar(*currentBatch, index, scale, rect);
-                currentSpriteWord.sprites.push_back(fontChar);
-                m_sprites.push_back(fontChar);
-
-                rect.size.width *= scale;
-                rect.size.height *= scale;
-
-                float yOffset = commonHeight - fontDef->yOffset * scale;
-
-                auto& pos = fontChar->m_obPosition;
-                pos.x = (
-                    nextX + fontDef->xOffset * scale + fontDef->rect.size.width * 0.5f * scale + kerningAmount
-                ) / scaleFactor;
-                pos.y = (
-                    nextY + yOffset - rect.size.height * 0.5f * scaleFactor
-                ) / scaleFactor;
-
-                // update kerning
-                auto advance = m_extraKerning + fontDef->xAdvance * scale + kerningAmount;
-                nextX += advance;
-                prevChar = c;
-
-                ++index;
-            }
-
-            currentSpriteWord.toX = nextX;
-
-            // add the word to the line
-            currentSpriteLine.push_back(std::move(currentSpriteWord));
-            currentSpriteWord.sprites.clear();
-            currentSpriteWord.xOffset = 0;
-        }
-
-        // add the line to the lines
-        spriteLines.push_back(std::move(currentSpriteLine));
-        currentSpriteLine.clear();
-    }
-
-    // start wrapping the lines
-    std::vector<CCNode*> currentLine;
-    nextX = 0;
-    auto maxWidth = m_wrapWidth / getScale();
-    for (auto& spriteLine : spriteLines) {
-        for (auto& word : spriteLine) {
-            // auto wordWidth = getWordWidth(word.sprites);
-            auto wordWidth = (word.toX - word.fromX) / scaleFactor;
-            // nextX += word.xOffset;
-
-            if (nextX + wordWidth > maxWidth) {
-                // wrap the line
-                m_lines.push_back(std::move(currentLine));
-                currentLine.clear();
-                nextX = 0;
-            }
-
-            if (!word.sprites.empty()) {
-                // add the word to the line
-                auto front = word.sprites.front();
-                float startX = front->m_obPosition.x - front->m_obContentSize.width * front->m_fScaleX * 0.5f;
-                for (auto& sprite : word.sprites) {
-                    sprite->m_obPosition.x += nextX - startX;
-                    currentLine.push_back(sprite);
-                }
-                nextX += wordWidth;
-            }
-
-            // append space
-            nextX += spaceWidth;
-        }
-
-        // add the last line
-        m_lines.push_back(std::move(currentLine));
-        currentLine.clear();
-        nextX = 0;
-    }
-
-    // recalculate Y positions
-    float commonHeightScaled = (m_lines.size() <= 1 ? commonHeight : lineHeight) / scaleFactor;
-    float nextY = commonHeightScaled * m_lines.size() - commonHeightScaled;
-    float maxLineWidth = 0;
-    for (auto& line : m_lines) {
-        for (auto& sprite : line) {
-            sprite->m_obPosition.y += nextY;
-            maxLineWidth = std::max(maxLineWidth, sprite->m_obPosition.x + sprite->m_obContentSize.width * sprite->m_fScaleX);
-        }
-        nextY -= commonHeightScaled;
+std::vector<LayoutFont> Label::getLayoutFonts() const {
+    std::vector<LayoutFont> fonts;
+    fonts.reserve(m_fontBatches.size() + 1);
+    fonts.push_back({m_fontConfig.get()});
+    for (auto& cfg : m_fontBatches) {
+        fonts.push_back({cfg.config.get(), cfg.scale});
     }
-
-    /// == DEBUG ==
-    // for (auto& line : spriteLines) {
-    //     for (auto& word : line) {
-    //         // auto wordWidth = getWordWidth(word.sprites);
-    //         auto wordWidth = (word.toX - word.fromX) / scaleFactor;
-    //
-    //         auto startX = word.sprites.front()->getPositionX() - word.sprites.front()->getScaledContentSize().width * 0.5f;
-    //         auto startY = word.sprites.front()->getPositionY() - word.sprites.front()->getScaledContentSize().height * 0.5f;
-    //
-    //         auto spaceFiller = cocos2d::CCLayerColor::create({255, 0, 0, 100}, wordWidth, commonHeight / scaleFactor);
-    //         spaceFiller->setPosition(startX, startY);
-    //         this->addChild(spaceFiller, 100);
-    //     }
-    // }
-    /// ===========
-
-    this->setContentSize({maxLineWidth, lineHeight * m_lines.size() / scaleFactor});
-
-    this->updateAlignment();
+    return fonts;
 }
 
-const BMFontDef* Label::getFontDefForChar(
-    char32_t c, const BMFontConfiguration* config, float& outScale, size_t& outIndex,
-    CachedBatch*& outBatch, BMFontConfiguration*& outConfig
-) {
-    auto& mainCharset = config->getFontDefDictionary();
-    auto it = mainCharset.find(c);
-    if (it != mainCharset.end()) {
-        return &it->second;
-    }
+class Label::NodeDelegate final : public LayoutDelegate {
+public:
+    NodeDelegate(Label* label, float scaleFactor) : m_label(label), m_scaleFactor(scaleFactor) {}
 
-    // check for uppercase version of the character
-    auto upper = std::toupper(c);
-    it = mainCharset.find(upper);
-    if (it != mainCharset.end()) {
-        return &it->second;
-    }
-
-    // check other fonts
-    for (size_t i = 0; i < m_fontBatches.size(); ++i) {
-        auto& [config, batch, scale] = m_fontBatches[i];
-        auto& charset = config->getFontDefDictionary();
-        it = charset.find(c);
-        if (it != charset.end()) {
-            outIndex = i + 1;
-            if (scale.has_value()) {
-                // manual font scale
-                outScale = scale.value();
-            } else {
-                // auto calculated scale
-                outScale = m_fontConfig->getCommonHeight() / config->getCommonHeight();
-            }
-            outIndex = i + 1;
-            outBatch = &batch;
-            outConfig = config;
-            return &it->second;
+    bool measureEmoji(EmojiFrame const& emoji, float commonHeight, LayoutMetrics& out) override {
+        if (!m_label->getEmojiBatch(emoji.page)) {
+            geode::log::warn("Emoji page {} could not be loaded", emoji.page);
+            return false;
         }
-    }
-
-    return nullptr;
-}
 
-std::u32string_view Label::parseEmoji(std::u32string_view text, uint32_t& index) const {
-    size_t emojiStart = index;
-    size_t i = index;
-
-    if (i >= text.size() || !(isEmoji(text[i])
-                              || isRegionalIndicator(text[i])
-                              || shouldParseDigitRegionalIndicator(text.substr(i)))
-    ) {
-        return {}; // not an emoji
-    }
-
-    // handle regional indicators
-    if (isRegionalIndicator(text[i])) {
-        // if the next character is also a regional indicator, check if we have it defined in the emoji map
-        if (i + 1 < text.size() && isRegionalIndicator(text[i + 1]) && m_emojiMap->contains(text.substr(i, 2))) {
-            ++i;
+        auto metrics = getEmojiMetrics(emoji, commonHeight, m_scaleFactor);
+        if (!metrics) {
+            geode::log::warn("Frame {} was not found", emoji.name);
+            return false;
         }
-    } else if (shouldParseDigitRegionalIndicator(text.substr(emojiStart))) {
-        i += 2;
-    } else {
-        // Parse the emoji components
-        while (i + 1 < text.size()) {
-            // handle skin tone modifiers
-            if (isSkinToneModifier(text[i + 1]) || isVariationSelector(text[i + 1])) {
-                ++i;
-            } else if (isZeroWidthJoiner(text[i + 1])) {
-                ++i;
-                if (i + 1 < text.size() && isEmoji(text[i + 1])) {
-                    ++i;
-                }
-            } else {
-                break;
-            }
-        }
-    }
 
-    index = i; // Update index to the end of the parsed emoji
-    return text.substr(emojiStart, i - emojiStart + 1);
-}
-
-void Label::checkForEmoji(
-    std::u32string_view text, uint32_t& index, float scaleFactor, float& nextX, float nextY, float commonHeight,
-    float& longestLine, std::vector<CCNode*>& currentLine, size_t& emojiIndex
-) {
-    if (!m_spriteSheetBatch) {
-        return;
+        out = { metrics->width, metrics->scale, const_cast<EmojiMetrics*>(metrics) };
+        return true;
     }
 
-    auto decodedEmoji = parseEmoji(text, index);
-    auto emojiIt = m_emojiMap->find(decodedEmoji);
-    if (emojiIt != m_emojiMap->end()) {
-        auto sprite = m_spriteSheetBatch[emojiIndex];
-        if (!sprite) {
-            // create new sprite
-            sprite = cocos2d::CCSprite::createWithSpriteFrameName(emojiIt->second);
-            if (!sprite) { return geode::log::warn("Frame {} was not found (create)", emojiIt->second); }
-            m_spriteSheetBatch.addChild(sprite, emojiIndex, emojiIndex);
-
-            // modify opacity and color
-            if (m_useEmojiColors) {
-                sprite->setColor(m_color);
-            }
-            sprite->setOpacity(m_opacity);
-        } else {
-            auto spriteFrame = cocos2d::CCSpriteFrameCache::get()->spriteFrameByName(emojiIt->second);
-            if (!spriteFrame) { return geode::log::warn("Frame {} was not found (update)", emojiIt->second); }
-            sprite->m_bVisible = true;
-            sprite->setDisplayFrame(spriteFrame);
-        }
+    bool measureCustom(
+        std::u32string_view sequence, std::u32string_view text, uint32_t& index,
+        float commonHeight, LayoutMetrics& out
+    ) override {
+        auto nodes = m_label->m_customNodeMap;
+        if (!nodes) { return false; }
 
-        // calculate size
-        auto size = sprite->getContentSize();
-        auto sizeInPixels = cocos2d::CCSize{
-            size.width * scaleFactor,
-            size.height * scaleFactor
-        };
-
-        // rescale to fit font height
-        auto sprScale = commonHeight / sizeInPixels.height;
-        sprite->setScale(sprScale);
-        sizeInPixels.width *= sprScale;
-
-        // update position
-        sprite->setPosition({
-            (nextX + sizeInPixels.width * .5f) / scaleFactor,
-            (nextY + commonHeight * .5f) / scaleFactor
-        });
-        nextX += sizeInPixels.width + m_extraKerning;
-
-        // update longest line
-        if (longestLine < nextX) {
-            longestLine = nextX;
-        }
-
-        currentLine.push_back(sprite);
-        m_sprites.push_back(sprite);
-        ++emojiIndex;
-    } else if (m_customNodeMap) {
-        auto it = m_customNodeMap->find(decodedEmoji);
-        if (it == m_customNodeMap->end()) { return; }
+        auto it = nodes->find(sequence);
+        if (it == nodes->end()) { return false; }
 
         auto node = it->second(text.substr(index), index);
-        if (!node) { return; }
-
-        // calculate size
-        auto size = node->getContentSize();
-        auto sizeInPixels = cocos2d::CCSize{
-            size.width * scaleFactor,
-            size.height * scaleFactor
-        };
+        if (!node) { return false; }
 
         // rescale to fit font height
-        auto sprScale = commonHeight / sizeInPixels.height;
-        node->setScale(sprScale);
-        sizeInPixels.width *= sprScale;
-
-        // update position
-        node->setPosition({
-            (nextX + sizeInPixels.width * .5f) / scaleFactor,
-            (nextY + commonHeight * .5f) / scaleFactor
-        });
-        nextX += sizeInPixels.width + m_extraKerning;
-
-        // update longest line
-        if (longestLine < nextX) {
-            longestLine = nextX;
-        }
+        auto size = node->getContentSize();
+        auto scale = commonHeight / (size.height * m_scaleFactor);
 
-        this->addChild(node, 0, m_customNodes.size());
-        currentLine.push_back(node);
-        m_customNodes.push_back(node);
+        out = { size.width * m_scaleFactor * scale, scale, node };
+        return true;
     }
-}
+
+private:
+    Label* m_label;
+    float m_scaleFactor;
+};
 
 cocos2d::CCSprite* Label::getSpriteForChar(
     CachedBatch& batch, size_t index, float scale, cocos2d::CCRect const& rect
@@ -1032,6 +647,7 @@ cocos2d::CCSprite* Label::getSpriteForChar(
         fontChar->setScale(scale);
         batch.addChild(fontChar, index, index);
         fontChar->release();
+        PROFILE_COUNT(SpritesCreated, 1);
 
         // Apply label properties
         fontChar->setOpacityModifyRGB(m_isOpacityModifyRGB);
@@ -1048,6 +664,12 @@ cocos2d::CCSprite* Label::getSpriteForChar(
 }
 
 void Label::updateChars() {
+    this->layoutChars(nullptr);
+}
+
+void Label::layoutChars(FitBox const* fit) {
+    PROFILE_SCOPE(UpdateChars);
+
     hideAllChars();
 
     //      if (m_useChunks) {
@@ -1055,126 +677,124 @@ void Label::updateChars() {
     //      }
 
     if (m_unicodeText.empty()) {
+        if (fit) this->setScale(1.f);
         return this->setContentSize({0.f, 0.f});
     }
 
-    if (m_useWrap) {
-        return updateCharsWrapped();
-    }
-
-    auto stringLen = m_unicodeText.size();
+    auto scaleFactor = cocos2d::CCDirector::get()->getContentScaleFactor();
+    auto fonts = getLayoutFonts();
+    NodeDelegate delegate(this, scaleFactor);
+
+    LayoutOptions options{
+        .scaleFactor = scaleFactor,
+        .extraKerning = m_extraKerning,
+        .extraLineSpacing = m_extraLineSpacing,
+        .wrap = m_useWrap,
+        .wrapWidth = m_wrapWidth / getScale(),
+        .breakWords = m_breakWords,
+        .alignment = m_alignment
+    };
+    LayoutContext context{fonts, m_emojiMap, &delegate, m_fallbackIndex.get()};
 
-    // Calculate the number of lines
-    uint32_t lines = 1;
-    for (uint32_t i = 0; i < stringLen; ++i) {
-        if (m_unicodeText[i] == '\n') {
-            ++lines;
-        }
+    // same as layoutText, split up so that every stage can be profiled
+    m_layout.clear();
+    {
+        PROFILE_SCOPE(Tokenize);
+        layout::tokenize(m_unicodeText, options, m_layout);
+    }
+    {
+        PROFILE_SCOPE(GlyphLookup);
+        layout::shape(m_unicodeText, context, options, m_layout);
     }
+    if (fit) {
+        // shaping doesn't depend on the wrap width, so only the line breaking is measured for each scale
+        PROFILE_SCOPE(FitToBox);
+        auto scale = layout::fitScale(context, options, m_layout, fit->width, fit->height, fit->minScale);
+        this->setScale(scale);
+        options.wrapWidth = m_wrapWidth / scale;
+    }
+    {
+        PROFILE_SCOPE(LineBreak);
+        layout::breakLines(context, options, m_layout);
+        layout::align(options, m_layout);
+    }
+
+    this->commitChars(scaleFactor);
+}
 
-    m_lines.clear();
-    m_lines.reserve(lines);
+void Label::commitChars(float scaleFactor) {
+    PROFILE_SCOPE(SpriteCommit);
+    PROFILE_COUNT(Glyphs, m_layout.glyphs.size());
 
     m_sprites.clear();
-    m_sprites.reserve(stringLen);
-
-    auto commonHeight = m_fontConfig->getCommonHeight();
-    auto lineHeight = commonHeight + m_extraLineSpacing;
-
-    BMFontConfiguration* currentConfig = m_fontConfig;
-    const BMFontDef* fontDef = nullptr;
-    char32_t prevChar = -1;
-    float kerningAmount = 0;
-    float nextX = 0;
-    float nextY = lineHeight * lines - lineHeight;
-    float longestLine = 0;
-    auto scaleFactor = cocos2d::CCDirector::get()->getContentScaleFactor();
+    m_sprites.reserve(m_layout.glyphs.size());
 
-    std::vector<CCNode*> currentLine;
     std::vector<size_t> indices(m_fontBatches.size() + 1, 0);
-    size_t emojiIndex = 0;
-
-    for (uint32_t i = 0; i < stringLen; ++i) {
-        char32_t c = m_unicodeText[i];
+    std::vector<size_t> emojiIndices(m_emojiBatches.size(), 0);
+
+    for (auto& glyph : m_layout.glyphs) {
+        switch (glyph.type) {
+            case LayoutGlyphType::Character: {
+                auto& batch = glyph.font == 0 ? m_mainBatch : m_fontBatches[glyph.font - 1].batch;
+                auto& index = indices[glyph.font];
+                auto& defRect = glyph.def->rect;
+                cocos2d::CCRect rect = {
+                    defRect.x / scaleFactor, defRect.y / scaleFactor,
+                    defRect.width / scaleFactor, defRect.height / scaleFactor
+                };
 
-        if (c == '\n') {
-            nextX = 0;
-            nextY -= lineHeight;
-            m_lines.push_back(std::move(currentLine));
-            currentLine.clear();
-            continue;
-        }
+                // Re-using existing sprites for performance reasons
+                auto fontChar = getSpriteForChar(batch, index, glyph.scale, rect);
+                fontChar->setPosition({glyph.x, glyph.y});
+                m_sprites.push_back(fontChar);
+                ++index;
+                break;
+            }
+            case LayoutGlyphType::Emoji: {
+                // the batch was already created while measuring the emoji
+                auto metrics = static_cast<const EmojiMetrics*>(glyph.handle);
+                auto batch = getEmojiBatch(glyph.font);
 
-        size_t fontIndex = 0;
-        float scale = 1.f;
-        auto* batch = &m_mainBatch;
-        if (m_spriteSheetBatch && shouldParseDigitRegionalIndicator(std::u32string_view(m_unicodeText).substr(i))) {
-            checkForEmoji(
-                m_unicodeText, i, scaleFactor,
-                nextX, nextY, commonHeight,
-                longestLine, currentLine,
-                emojiIndex
-            );
-            continue;
-        }
+                if (emojiIndices.size() <= glyph.font) {
+                    emojiIndices.resize(glyph.font + 1, 0);
+                }
+                auto& emojiIndex = emojiIndices[glyph.font];
+
+                auto sprite = (*batch)[emojiIndex];
+                if (!sprite) {
+                    // create new sprite
+                    sprite = cocos2d::CCSprite::createWithSpriteFrame(metrics->frame);
+                    batch->addChild(sprite, emojiIndex, emojiIndex);
+                    PROFILE_COUNT(SpritesCreated, 1);
+
+                    // modify opacity and color
+                    if (m_useEmojiColors) {
+                        sprite->setColor(m_color);
+                    }
+                    sprite->setOpacity(m_opacity);
+                } else {
+                    sprite->m_bVisible = true;
+                    sprite->setDisplayFrame(metrics->frame);
+                }
 
-        fontDef = getFontDefForChar(c, m_fontConfig, scale, fontIndex, batch, currentConfig);
-        if (!fontDef) {
-            checkForEmoji(
-                m_unicodeText, i, scaleFactor,
-                nextX, nextY, commonHeight,
-                longestLine, currentLine,
-                emojiIndex
-            );
-            continue;
+                sprite->setScale(glyph.scale);
+                sprite->setPosition({glyph.x, glyph.y});
+                m_sprites.push_back(sprite);
+                ++emojiIndex;
+                break;
+            }
+            case LayoutGlyphType::Custom: {
+                auto node = static_cast<CCNode*>(glyph.handle);
+                node->setScale(glyph.scale);
+                node->setPosition({glyph.x, glyph.y});
+                this->addChild(node, 0, m_customNodes.size());
+                m_customNodes.push_back(node);
+                break;
+            }
         }
-
-        auto& index = indices[fontIndex];
-        kerningAmount = kerningAmountForChars(prevChar, c, currentConfig) * scale;
-
-        Rect rect = {
-            fontDef->rect.origin.x / scaleFactor, fontDef->rect.origin.y / scaleFactor,
-            fontDef->rect.size.width / scaleFactor, fontDef->rect.size.height / scaleFactor
-        };
-
-        // Re-using existing sprites for performance reasons
-        auto fontChar = getSpriteForChar(*batch, index, scale, rect);
-        currentLine.push_back(fontChar);
-        m_sprites.push_back(fontChar);
-
-        rect.size.width *= scale;
-        rect.size.height *= scale;
-
-        float yOffset = commonHeight - fontDef->yOffset * scale;
-        Vector fontPos = {
-            nextX + fontDef->xOffset * scale + fontDef->rect.size.width * 0.5f * scale + kerningAmount,
-            nextY + yOffset - rect.size.height * 0.5f * scaleFactor
-        };
-        fontChar->setPosition({
-            fontPos.x / scaleFactor,
-            fontPos.y / scaleFactor
-        });
-
-        // update kerning
-        nextX += m_extraKerning + fontDef->xAdvance * scale + kerningAmount;
-        prevChar = c;
-
-        longestLine = std::max(longestLine, nextX);
-        ++index;
     }
-    m_lines.push_back(std::move(currentLine));
 
-    float width = longestLine;
-    if (fontDef && fontDef->xAdvance < fontDef->rect.size.width) {
-        width += fontDef->rect.size.width - fontDef->xAdvance;
-    }
-
-    this->setContentSize({
-        width / scaleFactor,
-        (commonHeight * lines + m_extraLineSpacing * (lines - 1)) / scaleFactor
-    });
-
-    this->updateAlignment();
+    this->setContentSize({m_layout.width, m_layout.height});
 }
 
 void Label::updateColors() const {
@@ -1184,7 +804,7 @@ void Label::updateColors() const {
             continue;
         }
 
-        if (sprite->m_pParent == m_spriteSheetBatch.node) {
+        if (isEmojiSprite(sprite)) {
             sprite->setColor(cocos2d::ccc3(255, 255, 255));
         } else {
             sprite->setColor(m_color);
@@ -1198,6 +818,14 @@ void Label::updateOpacity() const {
     }
 }
 
+Label::~Label() {
+    // the batches go away with the children, only the pages have to be handed back
+    if (!m_emojiPageReleaser) return;
+    for (size_t page = 0; page < m_emojiBatches.size(); page++) {
+        if (m_emojiBatches[page]) m_emojiPageReleaser(page);
+    }
+}
+
 bool Label::init(std::string_view text, std::string_view font, BMFontAlignment alignment, float scale) {
     m_fontConfig = BMFontConfiguration::create(font);
     if (!m_fontConfig) {
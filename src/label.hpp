@@ -1,87 +1,17 @@
 #pragma once
-#include <Geode/Result.hpp>
+#include <Geode/utils/cocos.hpp>
 #include <cocos2d.h>
+#include "bmfont.hpp"
+#include "text-layout.hpp"
 
 #include <cstddef>
 #include <cstdint>
 #include <functional>
+#include <memory>
 #include <string>
 #include <unordered_map>
 #include <vector>
 
-struct BMKerningPair {
-    uint32_t first = 0;
-    uint32_t second = 0;
-
-    bool operator==(const BMKerningPair& other) const = default;
-
-    uint64_t toInt() const {
-        return static_cast<uint64_t>(first) << 32 | second;
-    }
-};
-
-struct BMFontDef {
-    uint32_t charID = 0;
-    cocos2d::CCRect rect = {0, 0, 0, 0};
-    float xOffset = 0;
-    float yOffset = 0;
-    float xAdvance = 0;
-};
-
-struct BMFontPadding {
-    int left = 0, top = 0, right = 0, bottom = 0;
-};
-
-template <>
-struct std::hash<BMKerningPair> {
-    size_t operator()(BMKerningPair const& pair) const noexcept {
-        return std::hash<uint64_t>()(pair.toInt());
-    }
-};
-
-/// @brief Reimplementation of the CCBMFontConfiguration class, with a few modifications to make it more modern.
-class BMFontConfiguration {
-public:
-    static BMFontConfiguration* create(std::string_view fntFile);
-    static void purgeCachedData();
-    BMFontConfiguration() = default;
-
-protected:
-    bool initWithFNTfile(std::string_view fntFile);
-    bool initWithContents(std::string const& contents, std::string const& fntFile);
-
-private:
-    geode::Result<> parseInfoArguments(std::istringstream& line);
-    geode::Result<> parseImageFileName(std::istringstream& line, std::string const& fntFile);
-    geode::Result<> parseCommonArguments(std::istringstream& line);
-    geode::Result<> parseCharacterDefinition(std::istringstream& line);
-    geode::Result<> parseKerningEntry(std::istringstream& line);
-
-public:
-    std::unordered_map<uint32_t, BMFontDef> const& getFontDefDictionary() const { return m_fontDefDictionary; }
-    std::unordered_map<BMKerningPair, float> const& getKerningDictionary() const { return m_kerningDictionary; }
-    float getCommonHeight() const { return m_commonHeight; }
-    BMFontPadding const& getPadding() const { return m_padding; }
-    std::string const& getAtlasName() const { return m_atlasName; }
-
-protected:
-    std::unordered_map<uint32_t, BMFontDef> m_fontDefDictionary;
-    std::unordered_map<BMKerningPair, float> m_kerningDictionary;
-    float m_commonHeight = 0;
-    BMFontPadding m_padding;
-    std::string m_atlasName;
-};
-
-std::u32string utf8_to_utf32(std::string_view text);
-std::string utf32_to_utf8(std::u32string_view text);
-
-enum class BMFontAlignment {
-    Left,
-    Center,
-    Right,
-    Justify // TODO: implement justify
-};
-
 /// @brief Multifunctional label node, that is more optimized and feature complete than the available CCLabelBMFont/TextArea ones.
 /// Supports features like line wrapping, multiple fonts, batched emojis and more.
 class Label : public cocos2d::CCNode, public cocos2d::CCRGBAProtocol, public cocos2d::CCLabelProtocol {
@@ -111,7 +41,12 @@ public:
     static Label* createWrapped(std::string_view text, std::string_view font, BMFontAlignment alignment, float scale, float wrapWidth);
 
 public:
-    using EmojiMap = std::unordered_map<std::u32string_view, const char*>;
+    using EmojiMap = ::EmojiMap;
+    /// @brief Returns the atlas texture of an emoji page, loading its sprite frames if needed.
+    /// Counts the label as a user of the page until the matching EmojiPageReleaser call.
+    using EmojiPageLoader = cocos2d::CCTexture2D*(*)(size_t page);
+    /// @brief Called once the label no longer has a batch for an emoji page it loaded.
+    using EmojiPageReleaser = void(*)(size_t page);
     using CustomNodeMap = std::unordered_map<std::u32string_view, std::function<CCNode*(std::u32string_view, uint32_t&)>>;
 
     /// @brief Set the contents of the label.
@@ -123,7 +58,9 @@ public:
     /// @brief Add additional font to the label. (for multi-font labels)
     void addFont(std::string_view font, std::optional<float> scale = std::nullopt);
     /// @brief Activate support for emojis in the label.
-    void enableEmojis(std::string_view sheetFileName, const EmojiMap* frameNames);
+    /// Each page gets its own batch node, which is only created once an emoji from that page is used.
+    /// Pages are handed back to the releaser when the label is destroyed or switches loaders.
+    void enableEmojis(EmojiPageLoader pageLoader, EmojiPageReleaser pageReleaser, const EmojiMap* frameNames);
     /// @brief Activate support for custom nodes in the label.
     void enableCustomNodes(const CustomNodeMap* nodes);
     /// @brief Enable or disable line wrapping.
@@ -142,6 +79,11 @@ public:
     void setAlignment(BMFontAlignment alignment);
     /// @brief Resize the label to fit the width.
     void limitLabelWidth(float width, float defaultScale, float minScale);
+    /// @brief Set the text and pick the largest scale (at most 1) at which it fits in the box, wrapping at the box width.
+    /// The text is only shaped once, every candidate scale just measures the line breaking. Returns the chosen scale.
+    float fitToBox(std::string_view text, float width, float height, float minScale);
+    /// @brief Fit the current text in the box, see the overload above.
+    float fitToBox(float width, float height, float minScale);
 
     /// @brief Get extra kerning
     [[nodiscard]] float getExtraKerning() const { return m_extraKerning; }
@@ -154,6 +96,48 @@ public:
     /// @brief Set how many characters should be grouped when breaking words (set to -1 to disable)
     void setBreakWords(int chars) { m_breakWords = chars; }
 
+    /// @brief Placement data of an emoji, precomputed for a specific font height.
+    struct EmojiMetrics {
+        geode::Ref<cocos2d::CCSpriteFrame> frame; // sprite frame of the emoji
+        float width = 0.f;                        // width in pixels after scaling
+        float scale = 1.f;                        // sprite scale to match the font height
+    };
+
+    /// @brief Get cached metrics of an emoji, computing them on first use.
+    /// Returns nullptr if the sprite frame is not loaded. Main thread only, like the sprite frame cache.
+    static const EmojiMetrics* getEmojiMetrics(EmojiFrame const& emoji, float commonHeight, float scaleFactor);
+    /// @brief Clear cached emoji metrics. Must be called before emoji sprite frames get unloaded.
+    static void purgeEmojiMetrics();
+    /// @brief Clear cached metrics of the emojis on one atlas texture, before its sprite frames get unloaded.
+    static void purgeEmojiMetrics(cocos2d::CCTexture2D* texture);
+
+    /// @brief Layout settings for measure, same as the ones set on a label.
+    struct MeasureOptions {
+        float scale = 1.f;            // label scale, only affects the wrap width
+        float extraKerning = 0.f;     // see setExtraKerning
+        float extraLineSpacing = 0.f; // see setExtraLineSpacing
+        bool wrap = false;            // enable line wrapping
+        float wrapWidth = 0.f;        // maximum scaled content width before wrapping
+        int breakWords = -1;          // see setBreakWords
+    };
+
+    /// @brief Size of a text laid out by measure.
+    struct Measurement {
+        float width = 0.f;              // content width in points (before the label scale)
+        float height = 0.f;             // content height in points (before the label scale)
+        std::vector<float> lineWidths;  // width of every line in points
+
+        [[nodiscard]] size_t getLineCount() const { return lineWidths.size(); }
+    };
+
+    /// @brief Measure the content size a label would have, without creating any nodes or touching textures.
+    /// Plain text in the primary font only: emojis, custom nodes and additional fonts are not measured.
+    /// The font is only looked up, never loaded, so the result is empty until a label (or BMFontConfiguration::create)
+    /// has loaded it. That makes it safe to call from any thread.
+    static Measurement measure(std::string_view text, std::string_view font, MeasureOptions const& options);
+    /// @brief Measure a single line of text with default options.
+    static Measurement measure(std::string_view text, std::string_view font);
+
 protected:
     struct CachedBatch {
         cocos2d::CCSpriteBatchNode* node = nullptr; // batch node
@@ -173,37 +157,40 @@ protected:
         }
     };
 
-    static float kerningAmountForChars(uint32_t first, uint32_t second, const BMFontConfiguration* config);
+    /// @brief Creates nodes for emojis and custom nodes while the layout is computed. [Internal]
+    class NodeDelegate;
+
+    ~Label() override;
 
     /// @brief Hide all characters of the label.
     void hideAllChars();
 
-    /// @brief Update the characters of the label when it is not left-aligned.
-    void updateAlignment() const;
+    /// @brief Remove all emoji batches and hand their pages back to the releaser. [Internal]
+    void releaseEmojiBatches();
+
+    /// @brief Box the text is scaled to fit in, see fitToBox.
+    struct FitBox {
+        float width = 0.f;
+        float height = 0.f;
+        float minScale = 0.f;
+    };
 
-    static float getWordWidth(std::vector<cocos2d::CCSprite*> const& word);
+    /// @brief Lay out the text, picking the scale first if a box is given. [Internal]
+    void layoutChars(FitBox const* fit);
+    /// @brief Update the sprites to match the current layout. [Internal]
+    void commitChars(float scaleFactor);
 
-    /// @brief Update the characters of the label when it is wrapped.
-    /// Will calculate the line breaks and update the characters accordingly.
-    void updateCharsWrapped();
+    /// @brief Get the primary font followed by all additional fonts. [Internal]
+    std::vector<LayoutFont> getLayoutFonts() const;
 
-    /// @brief Find the font definition for the specified character. [Internal]
-    const BMFontDef* getFontDefForChar(
-        char32_t c, const BMFontConfiguration* config,
-        float& outScale, size_t& outIndex,
-        CachedBatch*& outBatch,
-        BMFontConfiguration*& outConfig
-    );
+    /// @brief Point the fallback index to the current font set, building it on first use. [Internal]
+    void updateFallbackIndex();
 
-    std::u32string_view parseEmoji(std::u32string_view text, uint32_t& index) const;
+    /// @brief Get or create the batch node for an emoji page. [Internal]
+    CachedBatch* getEmojiBatch(size_t page);
 
-    /// @brief Check for an emoji character and add it to the label if found. [Internal]
-    void checkForEmoji(
-        std::u32string_view text, uint32_t& index,
-        float scaleFactor, float& nextX, float nextY, float commonHeight,
-        float& longestLine, std::vector<CCNode*>& currentLine,
-        size_t& emojiIndex
-    );
+    /// @brief Whether the sprite belongs to one of the emoji batches. [Internal]
+    bool isEmojiSprite(cocos2d::CCSprite* sprite) const;
 
     /// @brief Fetches or creates a sprite with the provided rect. [Internal]
     cocos2d::CCSprite* getSpriteForChar(
@@ -212,8 +199,7 @@ protected:
     ) const;
 
 public:
-    /// @brief Update the characters of the label when it is not wrapped.
-    /// Automatically calculates the line breaks and updates the characters accordingly.
+    /// @brief Lay out the text and update the characters accordingly.
     void updateChars();
 
     /// @brief Update the colors of all characters.
@@ -268,7 +254,8 @@ protected:
     std::string m_font;                                  // primary font atlas name
     std::u32string m_unicodeText;                        // UTF-32 encoded text
     BMFontAlignment m_alignment = BMFontAlignment::Left; // text alignment
-    BMFontConfiguration* m_fontConfig = nullptr;         // primary font configuration
+    BMFontConfiguration::Handle m_fontConfig;            // primary font configuration
+    std::shared_ptr<const FontFallbackIndex> m_fallbackIndex; // merged lookup of the additional fonts, shared per font set
     int m_breakWords = -1;                               // break words when wrapping by N chars groups (default -1 = no break)
     bool m_useWrap = false;                              // enable line wrapping
     bool m_useEmojiColors = false;                       // enable emoji colorization
@@ -278,15 +265,15 @@ protected:
 
     // Children
     struct FontCfg {
-        BMFontConfiguration* config; // font configuration
+        BMFontConfiguration::Handle config; // font configuration
         CachedBatch batch;           // corresponding batch node
         std::optional<float> scale;  // auto scale by default
     };
 
-    CachedBatch m_mainBatch;            // Primary font batch
-    CachedBatch m_spriteSheetBatch;     // Sprite sheet batch for emoji characters
-    std::vector<FontCfg> m_fontBatches; // Font batches for alternate fonts
-    std::vector<CCNode*> m_customNodes; // Custom nodes to be added to the label
+    CachedBatch m_mainBatch;                 // Primary font batch
+    std::vector<CachedBatch> m_emojiBatches; // Sprite sheet batches for emoji characters (one per page)
+    std::vector<FontCfg> m_fontBatches;      // Font batches for alternate fonts
+    std::vector<CCNode*> m_customNodes;      // Custom nodes to be added to the label
 
     // Internal properties
     //  struct Chunk {
@@ -298,8 +285,10 @@ protected:
     //  };
 
     const EmojiMap* m_emojiMap = nullptr;            // emoji map (MAP SHOULD BE GLOBAL AND NEVER DESTROYED)
+    EmojiPageLoader m_emojiPageLoader = nullptr;     // loads emoji pages on demand
+    EmojiPageReleaser m_emojiPageReleaser = nullptr; // called for every page the loader returned
     const CustomNodeMap* m_customNodeMap = nullptr;  // custom node map (MAP SHOULD BE GLOBAL AND NEVER DESTROYED)
-    std::vector<std::vector<CCNode*>> m_lines;       // lines of characters
+    TextLayout m_layout;                             // result of the last layout (reused to avoid allocations)
     std::vector<cocos2d::CCSprite*> m_sprites;       // all sprites in the label (for faster access)
     //  std::vector<Chunk> m_chunks;                 // chunks containing metadata
     //  bool m_useChunks = false;                    // whether to use chunks instead of raw text
@@ -1,25 +1,73 @@
+#include <Geode/modify/CCDirector.hpp>
 #include <Geode/modify/CommentCell.hpp>
 #include <Geode/modify/GameManager.hpp>
+#include <Geode/modify/MenuLayer.hpp>
 #include <Geode/binding/GJComment.hpp>
+#include <Geode/binding/MultilineBitmapFont.hpp>
+#include <Geode/binding/TextArea.hpp>
 #include <Geode/Enums.hpp>
 #include <Geode/modify/ShareCommentLayer.hpp>
 #include <alphalaneous.alphas_geode_utils/include/NodeModding.h>
 
+#include "animated-sprite.hpp"
+#include "comment-layout.hpp"
+#include "comment-preview.hpp"
 #include "emoji-picker.hpp"
+#include "emoji-sheets.hpp"
+#include "emoji-suggestions.hpp"
 #include "emojis.hpp"
+#include "picker-prewarm.hpp"
+#include "profiler.hpp"
 
-std::string replaceEmojis(std::string_view text) {
-    auto result = std::string(text);
-    for (auto& [name, emoji] : EmojiReplacements) {
-        findAndReplace(result, name, emoji);
+static cocos2d::ccColor3B getTextAreaColor(const TextArea* textArea) {
+    auto lines = textArea->m_label->m_lines;
+    if (!lines || lines->count() == 0) {
+        return cocos2d::ccc3(255, 255, 255);
     }
-    return result;
+
+    auto lineChars = static_cast<cocos2d::CCLabelBMFont*>(lines->objectAtIndex(0))->getChildren();
+    if (!lineChars || lineChars->count() == 0) {
+        return cocos2d::ccc3(255, 255, 255);
+    }
+
+    return static_cast<cocos2d::CCSprite*>(lineChars->objectAtIndex(0))->getColor();
 }
 
+static bool s_emojiPagesTrimmed = false;
+
 class $modify(ClearFontCacheHook, GameManager) {
     void reloadAllStep5() {
         GameManager::reloadAllStep5();
         BMFontConfiguration::purgeCachedData();
+        Label::purgeEmojiMetrics();
+        FrameAnimation::purgeUnusedFrames();
+        EmojiPicker::purgeSectionCache();
+        s_emojiPagesTrimmed = false;
+    }
+};
+
+class $modify(PurgeCachesHook, cocos2d::CCDirector) {
+    // called on memory warnings
+    void purgeCachedData() {
+        EmojiPicker::purgeSectionCache();
+        BMFontConfiguration::purgeUnusedFonts();
+        releaseUnusedEmojiPages();
+        CCDirector::purgeCachedData();
+    }
+};
+
+class $modify(TrimEmojiPagesHook, MenuLayer) {
+    bool init() {
+        if (!MenuLayer::init()) return false;
+
+        // Geode loads every spritesheet with the game resources, unload the emoji pages
+        // so that they're only loaded when a comment needs them (after that, unused pages are freed on memory warnings)
+        if (!s_emojiPagesTrimmed) {
+            releaseUnusedEmojiPages();
+            s_emojiPagesTrimmed = true;
+        }
+
+        return true;
     }
 };
 
@@ -35,25 +83,26 @@ class $modify(CommentCellHook, CommentCell) {
             return;
         }
 
+        PROFILE_SCOPE(LoadFromComment);
+        PROFILE_COUNT(Comments, 1);
+
         Label* newText;
         cocos2d::ccColor3B changedColor;
-        auto commentString = replaceEmojis(comment->m_commentString);
-        float maxWidth = 315.f;
+        std::string commentString;
+        {
+            PROFILE_SCOPE(ReplaceEmojis);
+            commentString = replaceEmojis(comment->m_commentString);
+        }
+        float maxWidth = 0.f; // only set for single line labels, wrapped ones are fit into the text box
         float defaultScale = 1.f;
 
         if (auto oldText = static_cast<TextArea*>(m_mainLayer->getChildByID("comment-text-area"))) {
             oldText->setVisible(false);
             changedColor = getTextAreaColor(oldText);
 
-            // rescale very long comments
-            auto length = commentString.size();
-            float scale = length > 64 ? 1.f - std::min((length - 64) * 0.05f, 0.3f) : 1.f;
-
-            newText = Label::createWrapped("", "chatFont.fnt", scale, 315.f);
-            newText->setExtraLineSpacing(12.f);
-            newText->setBreakWords(48);
+            newText = createCommentLabel();
             newText->setAnchorPoint({0.f, 0.5f});
-            newText->setPosition({11.f, m_accountComment ? 38.f : 33.f});
+            newText->setPosition({11.f, getCommentTextY(m_accountComment)});
             newText->setID("comment-text-area"_spr);
         }
         else if (auto oldLabel = static_cast<cocos2d::CCLabelBMFont*>(m_mainLayer->getChildByID("comment-text-label"))) {
@@ -72,10 +121,15 @@ class $modify(CommentCellHook, CommentCell) {
         }
 
         newText->setColor(changedColor);
-        newText->enableCustomNodes(&CustomNodeSheet);
-        newText->enableEmojis("EmojiSheet.png"_spr, &EmojiSheet);
-        newText->setString(commentString);
-        newText->limitLabelWidth(maxWidth, defaultScale, 0.1f);
+        if (maxWidth > 0.f) {
+            newText->enableCustomNodes(&CustomNodeSheet);
+            newText->enableEmojis(&retainEmojiPage, &releaseEmojiPage, &EmojiSheet);
+            newText->setString(commentString);
+            newText->limitLabelWidth(maxWidth, defaultScale, 0.1f);
+        } else {
+            // rescale long comments, so they don't overflow the cell
+            setCommentText(newText, commentString, m_accountComment);
+        }
 
         m_mainLayer->addChild(newText);
     }
@@ -99,5 +153,30 @@ class $nodeModify(ShareCommentLayerHook, ShareCommentLayer) {
         btn->setID("emoji-picker"_spr);
         btn->setPosition(175.f, 36.5f);
         self->m_buttonMenu->addChild(btn);
+
+        // ":name" autocomplete, shown right above the input
+        if (auto input = self->m_commentInput; input && input->getParent()) {
+            auto suggestions = EmojiSuggestions::create(input);
+            suggestions->setID("emoji-suggestions"_spr);
+            suggestions->setPosition(input->getPositionX(), input->getPositionY() + 32.f);
+            input->getParent()->addChild(suggestions, 10);
+            geode::cocos::handleTouchPriority(self);
+        }
+
+        if (geode::Mod::get()->getSettingValue<bool>("prewarm-emoji-picker")) {
+            auto prewarmer = PickerPrewarmer::create();
+            prewarmer->setID("picker-prewarmer"_spr);
+            self->addChild(prewarmer);
+        }
+
+        if (geode::Mod::get()->getSettingValue<bool>("comment-preview")) {
+            if (auto input = self->m_commentInput; input && input->getParent()) {
+                auto preview = CommentPreview::create(input);
+                preview->setID("comment-preview"_spr);
+                preview->setScale(0.8f);
+                preview->setPosition(input->getPositionX(), input->getPositionY() - 22.f);
+                input->getParent()->addChild(preview, 10);
+            }
+        }
     }
 };
\ No newline at end of file
@@ -0,0 +1,55 @@
+#include "picker-prewarm.hpp"
+#include "emoji-picker.hpp"
+#include "emoji-sheets.hpp"
+#include "profiler.hpp"
+
+PickerPrewarmer* PickerPrewarmer::create() {
+    auto ret = new PickerPrewarmer();
+    if (ret->init()) {
+        ret->autorelease();
+        return ret;
+    }
+    delete ret;
+    return nullptr;
+}
+
+bool PickerPrewarmer::init() {
+    if (!CCNode::init()) {
+        return false;
+    }
+
+    // starts on the next frame, after the layer finished opening
+    this->scheduleUpdate();
+    return true;
+}
+
+void PickerPrewarmer::update(float) {
+    PROFILE_SCOPE(PickerPrewarm);
+
+    auto start = std::chrono::steady_clock::now();
+    do {
+        if (!this->step()) {
+            m_stage = static_cast<Stage>(static_cast<uint8_t>(m_stage) + 1);
+        }
+    } while (m_stage != Stage::Done && std::chrono::steady_clock::now() - start < FrameBudget);
+
+    if (m_stage == Stage::Done) {
+        this->unscheduleUpdate();
+    }
+}
+
+bool PickerPrewarmer::step() {
+    switch (m_stage) {
+        case Stage::Pages:
+            if (m_page >= getEmojiPageCount()) return false;
+            loadEmojiPage(m_page++);
+            return true;
+        case Stage::Sections:
+            return EmojiPicker::prewarmNextSection();
+        case Stage::Cells:
+            EmojiPicker::prewarmVisibleCells();
+            return false;
+        default:
+            return false;
+    }
+}
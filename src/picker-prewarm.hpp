@@ -0,0 +1,31 @@
+#pragma once
+#include <cocos2d.h>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+
+/// @brief Builds the emoji picker ahead of time, a little every frame, so that opening it doesn't stall.
+/// Loads the emoji pages, then builds the cached category sections and the cells of their first screen.
+class PickerPrewarmer final : public cocos2d::CCNode {
+public:
+    static constexpr auto FrameBudget = std::chrono::microseconds(2000); // work done per frame, at least one step
+
+    static PickerPrewarmer* create();
+
+protected:
+    enum class Stage : uint8_t {
+        Pages,    // emoji atlases and their sprite frames
+        Sections, // cached picker sections, one category per step
+        Cells,    // buttons visible when the picker opens
+        Done
+    };
+
+    bool init() override;
+    void update(float dt) override;
+    /// @brief Do one unit of work of the current stage. Returns false once the stage is finished.
+    bool step();
+
+protected:
+    Stage m_stage = Stage::Pages;
+    size_t m_page = 0; // next page to load
+};
@@ -0,0 +1,152 @@
+#include "profiler.hpp"
+#include "bmfont.hpp"
+#include <Geode/loader/Log.hpp>
+#include <Geode/loader/Mod.hpp>
+#include <Geode/utils/file.hpp>
+#include <fmt/format.h>
+#include <bit>
+
+using namespace profiler;
+
+static constexpr std::array<std::string_view, static_cast<size_t>(Metric::Count)> MetricNames = {
+    "load-from-comment", "replace-emojis", "set-string", "update-chars",
+    "tokenize", "glyph-lookup", "line-break", "sprite-commit",
+    "picker-setup", "animation-update", "emoji-search", "picker-prewarm",
+    "fit-to-box"
+};
+
+static constexpr std::array<std::string_view, static_cast<size_t>(Counter::Count)> CounterNames = {
+    "comments", "glyphs", "sprites-created", "animation-frames"
+};
+
+static std::array<Histogram, static_cast<size_t>(Metric::Count)> s_histograms;
+static std::array<std::atomic<uint64_t>, static_cast<size_t>(Counter::Count)> s_counters{};
+
+size_t Histogram::bucketFor(uint64_t value) {
+    if (value < SubBuckets) return value;
+    auto exponent = 63 - std::countl_zero(value);
+    auto mantissa = (value >> (exponent - 2)) & (SubBuckets - 1);
+    return (exponent - 1) * SubBuckets + mantissa;
+}
+
+uint64_t Histogram::bucketValue(size_t bucket) {
+    if (bucket < SubBuckets) return bucket;
+    auto exponent = bucket / SubBuckets + 1;
+    auto mantissa = bucket % SubBuckets;
+    // middle of the bucket range
+    auto low = (SubBuckets + mantissa) << (exponent - 2);
+    return low + (1ull << (exponent - 2)) / 2;
+}
+
+void Histogram::record(uint64_t value) {
+    m_buckets[bucketFor(value)].fetch_add(1, std::memory_order_relaxed);
+    m_count.fetch_add(1, std::memory_order_relaxed);
+    m_total.fetch_add(value, std::memory_order_relaxed);
+
+    auto max = m_max.load(std::memory_order_relaxed);
+    while (value > max && !m_max.compare_exchange_weak(max, value, std::memory_order_relaxed)) {}
+}
+
+void Histogram::reset() {
+    for (auto& bucket : m_buckets) {
+        bucket.store(0, std::memory_order_relaxed);
+    }
+    m_count.store(0, std::memory_order_relaxed);
+    m_total.store(0, std::memory_order_relaxed);
+    m_max.store(0, std::memory_order_relaxed);
+}
+
+uint64_t Histogram::percentile(double p) const {
+    auto total = count();
+    if (total == 0) return 0;
+
+    auto target = static_cast<uint64_t>(p * static_cast<double>(total - 1)) + 1;
+    uint64_t seen = 0;
+    for (size_t i = 0; i < BucketCount; ++i) {
+        seen += m_buckets[i].load(std::memory_order_relaxed);
+        if (seen >= target) {
+            return std::min(bucketValue(i), max());
+        }
+    }
+    return max();
+}
+
+void profiler::record(Metric metric, uint64_t nanoseconds) {
+    s_histograms[static_cast<size_t>(metric)].record(nanoseconds);
+}
+
+void profiler::count(Counter counter, uint64_t amount) {
+    s_counters[static_cast<size_t>(counter)].fetch_add(amount, std::memory_order_relaxed);
+}
+
+void profiler::reset() {
+    for (auto& histogram : s_histograms) {
+        histogram.reset();
+    }
+    for (auto& counter : s_counters) {
+        counter.store(0, std::memory_order_relaxed);
+    }
+}
+
+void profiler::dumpToLog() {
+    geode::log::info("Profiling results (microseconds):");
+    for (size_t i = 0; i < s_histograms.size(); ++i) {
+        auto& histogram = s_histograms[i];
+        if (histogram.count() == 0) continue;
+
+        geode::log::info(
+            "{:<18} count={:<8} mean={:<10.2f} p50={:<10.2f} p99={:<10.2f} max={:.2f}",
+            MetricNames[i], histogram.count(),
+            histogram.total() / 1000.0 / histogram.count(),
+            histogram.percentile(0.5) / 1000.0,
+            histogram.percentile(0.99) / 1000.0,
+            histogram.max() / 1000.0
+        );
+    }
+    for (size_t i = 0; i < s_counters.size(); ++i) {
+        geode::log::info("{:<18} {}", CounterNames[i], s_counters[i].load(std::memory_order_relaxed));
+    }
+
+    auto fonts = BMFontConfiguration::getCacheStats();
+    geode::log::info("{:<18} {} ({} in use), {:.1f} KiB", "font-cache", fonts.fonts, fonts.fontsInUse, fonts.bytes / 1024.0);
+}
+
+std::string profiler::toJson() {
+    std::string json = "{\n  \"metrics\": {";
+    for (size_t i = 0; i < s_histograms.size(); ++i) {
+        auto& histogram = s_histograms[i];
+        json += fmt::format(
+            "{}\n    \"{}\": {{ \"count\": {}, \"total_ns\": {}, \"p50_ns\": {}, \"p90_ns\": {}, \"p99_ns\": {}, \"max_ns\": {} }}",
+            i == 0 ? "" : ",", MetricNames[i], histogram.count(), histogram.total(),
+            histogram.percentile(0.5), histogram.percentile(0.9), histogram.percentile(0.99), histogram.max()
+        );
+    }
+    json += "\n  },\n  \"counters\": {";
+    for (size_t i = 0; i < s_counters.size(); ++i) {
+        json += fmt::format(
+            "{}\n    \"{}\": {}",
+            i == 0 ? "" : ",", CounterNames[i], s_counters[i].load(std::memory_order_relaxed)
+        );
+    }
+    json += "\n  }\n}\n";
+    return json;
+}
+
+void profiler::dumpToFile() {
+    auto path = geode::Mod::get()->getSaveDir() / "profile.json";
+    if (auto res = geode::utils::file::writeString(path, toJson()); res.isErr()) {
+        geode::log::warn("Failed to write profiling results: {}", res.unwrapErr());
+    }
+}
+
+$execute {
+    // launch with --geode:prevter.comment_emojis.profile to record from startup
+    detail::enabled = geode::Mod::get()->getLaunchFlag("profile");
+}
+
+$on_mod(DataSaved) {
+    if (isEnabled()) {
+        dumpToLog();
+        dumpToFile();
+    }
+}
@@ -0,0 +1,116 @@
+#pragma once
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+
+// Lightweight instrumentation for comment rendering.
+// Only compiled in when COMMENT_EMOJIS_PROFILING is defined (see CMakeLists.txt),
+// and only records when the game is launched with --geode:prevter.comment_emojis.profile.
+// Results are dumped to the log and to "profile.json" in the mod save directory whenever the game saves.
+
+namespace profiler {
+    enum class Metric : uint8_t {
+        LoadFromComment, // CommentCell::loadFromComment hook
+        ReplaceEmojis,   // placeholder replacement
+        SetString,       // Label::setString (includes updateChars)
+        UpdateChars,     // Label::updateChars
+        Tokenize,        // layout: splitting into runs
+        GlyphLookup,     // layout: font and emoji lookup
+        LineBreak,       // layout: line breaking and alignment
+        SpriteCommit,    // creating and updating sprites
+        PickerSetup,     // EmojiPicker::setup
+        AnimationUpdate, // FrameAnimation::update
+        EmojiSearch,     // EmojiPicker::setSearchQuery
+        PickerPrewarm,   // PickerPrewarmer::update
+        FitToBox,        // layout: searching the scale of Label::fitToBox
+        Count
+    };
+
+    enum class Counter : uint8_t {
+        Comments,        // comments rendered
+        Glyphs,          // glyphs committed to sprites
+        SpritesCreated,  // new sprites created (not reused)
+        AnimationFrames, // animation frames loaded from disk
+        Count
+    };
+
+    /// @brief Lock-free histogram of durations in nanoseconds.
+    /// Every power of two is split into 4 buckets, so percentiles are within ~20% of the real value.
+    class Histogram {
+    public:
+        static constexpr size_t SubBuckets = 4;
+        static constexpr size_t BucketCount = 64 * SubBuckets;
+
+        void record(uint64_t value);
+        void reset();
+
+        [[nodiscard]] uint64_t count() const { return m_count.load(std::memory_order_relaxed); }
+        [[nodiscard]] uint64_t total() const { return m_total.load(std::memory_order_relaxed); }
+        [[nodiscard]] uint64_t max() const { return m_max.load(std::memory_order_relaxed); }
+        /// @brief Get an approximate percentile (0-1), in nanoseconds.
+        [[nodiscard]] uint64_t percentile(double p) const;
+
+    private:
+        static size_t bucketFor(uint64_t value);
+        static uint64_t bucketValue(size_t bucket);
+
+        std::array<std::atomic<uint64_t>, BucketCount> m_buckets{};
+        std::atomic<uint64_t> m_count = 0;
+        std::atomic<uint64_t> m_total = 0;
+        std::atomic<uint64_t> m_max = 0;
+    };
+
+    namespace detail {
+        inline std::atomic<bool> enabled = false;
+    }
+
+    /// @brief Whether measurements are currently being recorded.
+    inline bool isEnabled() { return detail::enabled.load(std::memory_order_relaxed); }
+
+    void record(Metric metric, uint64_t nanoseconds);
+    void count(Counter counter, uint64_t amount = 1);
+
+    /// @brief Clear all recorded data.
+    void reset();
+    /// @brief Print all metrics to the log.
+    void dumpToLog();
+    /// @brief Serialize all metrics as JSON.
+    std::string toJson();
+    /// @brief Write all metrics to "profile.json" in the mod save directory.
+    void dumpToFile();
+
+    class ScopedTimer {
+    public:
+        explicit ScopedTimer(Metric metric) : m_metric(metric), m_active(isEnabled()) {
+            if (m_active) m_start = std::chrono::steady_clock::now();
+        }
+
+        ~ScopedTimer() {
+            if (!m_active) return;
+            auto elapsed = std::chrono::steady_clock::now() - m_start;
+            record(m_metric, std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count());
+        }
+
+        ScopedTimer(ScopedTimer const&) = delete;
+        ScopedTimer& operator=(ScopedTimer const&) = delete;
+
+    private:
+        std::chrono::steady_clock::time_point m_start;
+        Metric m_metric;
+        bool m_active;
+    };
+}
+
+#ifdef COMMENT_EMOJIS_PROFILING
+#define PROFILE_CONCAT_IMPL(a, b) a##b
+#define PROFILE_CONCAT(a, b) PROFILE_CONCAT_IMPL(a, b)
+#define PROFILE_SCOPE(metric) ::profiler::ScopedTimer PROFILE_CONCAT(profileScope_, __LINE__)(::profiler::Metric::metric)
+#define PROFILE_COUNT(counter, amount) (::profiler::isEnabled() ? ::profiler::count(::profiler::Counter::counter, amount) : void())
+#else
+#define PROFILE_SCOPE(metric) (void) 0
+#define PROFILE_COUNT(counter, amount) (void) 0
+#endif
@@ -1,17 +1,150 @@
 #include "scroll-layer.hpp"
 #include <algorithm>
+#include <chrono>
 #include <cmath>
+#include <vector>
 #include <Geode/loader/Mod.hpp>
-#include <Geode/ui/ScrollLayer.hpp>
+#include <Geode/loader/SettingV3.hpp>
 #include <Geode/utils/cocos.hpp>
 
 // all thanks to https://github.com/CallocGD/GD-2.205-Decompiled
 // and also from https://github.com/geode-sdk/geode
 
+ScrollContentLayer* ScrollContentLayer::create(float width, float height) {
+    auto ret = new ScrollContentLayer();
+    if (ret->init()) {
+        ret->setContentSize({ width, height });
+        ret->autorelease();
+        return ret;
+    }
+    delete ret;
+    return nullptr;
+}
+
+void ScrollContentLayer::visit() {
+    auto parent = this->getParent();
+    if (!m_bVisible || !parent || (m_pGrid && m_pGrid->isActive())) {
+        return CCLayer::visit();
+    }
+
+    // visible area of the scroll layer in our space, follows the current scroll offset
+    auto bottomLeft = this->convertToNodeSpace(parent->convertToWorldSpace({ 0.f, 0.f }));
+    auto topRight = this->convertToNodeSpace(parent->convertToWorldSpace(parent->getContentSize()));
+    cocos2d::CCRect view(
+        std::min(bottomLeft.x, topRight.x), std::min(bottomLeft.y, topRight.y),
+        std::abs(topRight.x - bottomLeft.x), std::abs(topRight.y - bottomLeft.y)
+    );
+
+    kmGLPushMatrix();
+    this->transform();
+    visitChildren(this, view);
+    kmGLPopMatrix();
+    this->setOrderOfArrival(0);
+}
+
+void ScrollContentLayer::visitChildren(CCNode* node, cocos2d::CCRect const& view) {
+    if (node->getChildrenCount() == 0) {
+        return node->draw();
+    }
+
+    node->sortAllChildren();
+
+    bool drawn = false;
+    for (auto child : geode::cocos::CCArrayExt<CCNode*>(node->getChildren())) {
+        if (!drawn && child->getZOrder() >= 0) {
+            node->draw();
+            drawn = true;
+        }
+
+        auto box = child->boundingBox();
+        if (box.size.width != 0.f || box.size.height != 0.f) {
+            if (box.intersectsRect(view)) child->visit();
+            continue;
+        }
+
+        auto grid = child->getGrid();
+        if (!child->isVisible() || (grid && grid->isActive())) {
+            child->visit();
+            continue;
+        }
+
+        // group node, cull its children against the view in its own space
+        kmGLPushMatrix();
+        child->transform();
+        visitChildren(child, cocos2d::CCRectApplyAffineTransform(view, child->parentToNodeTransform()));
+        kmGLPopMatrix();
+        child->setOrderOfArrival(0);
+    }
+
+    if (!drawn) {
+        node->draw();
+    }
+}
+
+static bool isSmoothScrollEnabled() {
+    static bool val = (geode::listenForSettingChanges<bool>("smooth-scrolling", [](bool value) {
+        val = value;
+    }), geode::Mod::get()->getSettingValue<bool>("smooth-scrolling"));
+    return val;
+}
+
 void ScrollLayer::scrollWheel(float pointX, float pointY) {
-    if (pointX != 0.0) {
-        CCScrollLayerExt::scrollLayer(pointX);
+    if (!m_scrollWheelEnabled) {
+        return;
+    }
+
+    // the vertical wheel comes first, horizontal layers also take it when there's no horizontal wheel
+    auto delta = this->isVertical() || pointY == 0.f ? pointX : pointY;
+    if (delta == 0.f) {
+        return;
     }
+
+    // with culling, gliding over a few frames only visits the rows revealed on each of them
+    this->syncPhysics();
+    m_physics.scrollBy(delta, isSmoothScrollEnabled());
+    this->applyPhysics();
+}
+
+static double getTouchTime() {
+    return std::chrono::duration<double>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+bool ScrollLayer::isVertical() const {
+    return !m_disableVertical;
+}
+
+void ScrollLayer::syncPhysics() {
+    // the content can be resized or moved by others at any time
+    auto viewSize = this->getContentSize();
+    auto contentSize = m_contentLayer->getContentSize();
+    if (this->isVertical()) {
+        // shorter content stays at the top
+        auto top = viewSize.height - contentSize.height;
+        m_physics.setBounds(top, std::max(top, 0.f), viewSize.height);
+        m_physics.setPosition(m_contentLayer->getPositionY());
+    } else {
+        m_physics.setBounds(std::min(viewSize.width - contentSize.width, 0.f), 0.f, viewSize.width);
+        m_physics.setPosition(m_contentLayer->getPositionX());
+    }
+}
+
+void ScrollLayer::applyPhysics() {
+    auto position = static_cast<float>(m_physics.getPosition());
+    if (this->isVertical()) {
+        m_contentLayer->setPositionY(position);
+    } else {
+        m_contentLayer->setPositionX(position);
+    }
+}
+
+void ScrollLayer::update(float dt) {
+    if (m_physics.isDragging() || !m_physics.isMoving()) {
+        return;
+    }
+
+    this->syncPhysics();
+    m_physics.update(dt);
+    this->applyPhysics();
 }
 
 bool ScrollLayer::ccTouchBegan(cocos2d::CCTouch *touch, cocos2d::CCEvent *event) {
@@ -19,40 +152,55 @@ bool ScrollLayer::ccTouchBegan(cocos2d::CCTouch *touch, cocos2d::CCEvent *event)
         return false;
     }
 
-    if (CCScrollLayerExt::ccTouchBegan(touch, event)) {
-        m_touchStart = touch;
-        auto touchPos = cocos2d::CCDirector::get()->convertToGL(m_touchStart->getLocationInView());
-        m_touchStartPosition2 = touchPos;
-        m_touchPosition2 = touchPos;
-        m_touchLastY = m_touchPosition2.y;
-        return true;
+    auto point = this->convertTouchToNodeSpace(touch);
+    auto size = this->getContentSize();
+    if (!cocos2d::CCRect(0.f, 0.f, size.width, size.height).containsPoint(point)) {
+        return false;
     }
 
-    return false;
+    m_touchStart = touch;
+    auto touchPos = cocos2d::CCDirector::get()->convertToGL(m_touchStart->getLocationInView());
+    m_touchStartPosition2 = touchPos;
+    m_touchPosition2 = touchPos;
+    m_touchLastY = this->isVertical() ? touchPos.y : touchPos.x;
+
+    this->syncPhysics();
+    m_physics.beginDrag(getTouchTime());
+    this->applyPhysics();
+    return true;
 }
 
 void ScrollLayer::ccTouchCancelled(cocos2d::CCTouch *touch, cocos2d::CCEvent *event) {
     if (m_cancellingTouches) return;
     if (!m_touchMoved) return;
-    CCScrollLayerExt::ccTouchCancelled(touch, event);
+    m_physics.endDrag(getTouchTime());
     touchFinish(touch);
 }
 
 void ScrollLayer::ccTouchEnded(cocos2d::CCTouch *touch, cocos2d::CCEvent *event) {
-    CCScrollLayerExt::ccTouchEnded(touch, event);
+    m_physics.endDrag(getTouchTime());
     touchFinish(touch);
     m_cancellingTouches = false;
 }
 
 void ScrollLayer::ccTouchMoved(cocos2d::CCTouch *touch, cocos2d::CCEvent *event) {
-    CCScrollLayerExt::ccTouchMoved(touch, event);
     m_touchMoved = true;
+
+    // follow the finger in our space, the physics add resistance past the edges
+    auto delta = this->convertToNodeSpace(touch->getLocation()) - this->convertToNodeSpace(touch->getPreviousLocation());
+    this->syncPhysics();
+    m_physics.drag(this->isVertical() ? delta.y : delta.x, getTouchTime());
+    this->applyPhysics();
+
     auto touchPoint = cocos2d::CCDirector::get()->convertToGL(touch->getLocationInView());
     if (touch == m_touchStart) {
         m_touchPosition2 = m_touchPosition2 - touchPoint;
     }
-    if (fabsf(touchPoint.y - m_touchLastY) >= 10.F) {
-        m_touchLastY = touchPoint.y;
+
+    // take the touch from the buttons below once it moved along the scroll axis
+    auto axisPosition = this->isVertical() ? touchPoint.y : touchPoint.x;
+    if (fabsf(axisPosition - m_touchLastY) >= 10.F) {
+        m_touchLastY = axisPosition;
         cancelAndStoleTouch(touch, event);
     }
 }
@@ -85,7 +233,7 @@ ScrollLayer::ScrollLayer(cocos2d::CCRect const& rect, bool scrollWheelEnabled, b
     m_cutContent = true;
 
     m_contentLayer->removeFromParent();
-    m_contentLayer = geode::GenericContentLayer::create(rect.size.width, rect.size.height);
+    m_contentLayer = ScrollContentLayer::create(rect.size.width, rect.size.height);
     m_contentLayer->setID("content-layer");
     m_contentLayer->setAnchorPoint({ 0, 0 });
     this->CCNode::addChild(m_contentLayer);
@@ -97,6 +245,7 @@ ScrollLayer::ScrollLayer(cocos2d::CCRect const& rect, bool scrollWheelEnabled, b
 
     this->CCLayer::setMouseEnabled(true);
     this->CCLayer::setTouchEnabled(true);
+    this->scheduleUpdate();
 
     cocos2d::CCTouchDispatcher::get()->registerForcePrio(this, 2);
 }
@@ -105,53 +254,82 @@ ScrollLayer::~ScrollLayer() {
     cocos2d::CCTouchDispatcher::get()->unregisterForcePrio(this);
 }
 
+// Clip rects of the scroll layers being visited, in world space points.
+// Tracked on the CPU so that nesting doesn't need to read the scissor state back from GL,
+// which stalls on some mobile drivers. Scissors set by other nodes are not taken into account.
+static std::vector<cocos2d::CCRect>& getScissorStack() {
+    static std::vector<cocos2d::CCRect> s_stack;
+    return s_stack;
+}
+
+static cocos2d::CCRect intersectRects(cocos2d::CCRect const& a, cocos2d::CCRect const& b) {
+    auto minX = std::max(a.getMinX(), b.getMinX());
+    auto minY = std::max(a.getMinY(), b.getMinY());
+    auto maxX = std::min(a.getMaxX(), b.getMaxX());
+    auto maxY = std::min(a.getMaxY(), b.getMaxY());
+    return { minX, minY, std::max(maxX - minX, 0.f), std::max(maxY - minY, 0.f) };
+}
+
+static void applyScissor(cocos2d::CCRect const& rect) {
+    cocos2d::CCEGLView::get()->setScissorInPoints(rect.origin.x, rect.origin.y, rect.size.width, rect.size.height);
+}
+
 void ScrollLayer::visit() {
-    int previousRect[4];
-    bool previousScissor = glIsEnabled(GL_SCISSOR_TEST);
-
-    if (m_cutContent && this->isVisible()) {
-        if (previousScissor) {
-            glGetIntegerv(GL_SCISSOR_BOX, previousRect);
-        } else {
-            glEnable(GL_SCISSOR_TEST);
-        }
+    if (!m_cutContent || !this->isVisible() || !this->getParent()) {
+        return CCNode::visit();
+    }
 
-        if (this->getParent()) {
-            auto const bottomLeft = this->convertToWorldSpace(ccp(0, 0));
-            auto const topRight = this->convertToWorldSpace(this->getContentSize());
-            cocos2d::CCSize const size = topRight - bottomLeft;
+    auto const bottomLeft = this->convertToWorldSpace(ccp(0, 0));
+    auto const topRight = this->convertToWorldSpace(this->getContentSize());
+    cocos2d::CCRect rect(bottomLeft.x, bottomLeft.y, topRight.x - bottomLeft.x, topRight.y - bottomLeft.y);
 
-            cocos2d::CCEGLView::get()->setScissorInPoints(bottomLeft.x, bottomLeft.y, size.width, size.height);
-        }
+    // nested scroll layers only draw inside their parent's clip
+    auto& stack = getScissorStack();
+    if (stack.empty()) {
+        glEnable(GL_SCISSOR_TEST);
+    } else {
+        rect = intersectRects(rect, stack.back());
     }
+    stack.push_back(rect);
 
-    CCNode::visit();
+    if (rect.size.width > 0.f && rect.size.height > 0.f) {
+        applyScissor(rect);
+        CCNode::visit();
+    }
 
-    if (m_cutContent && this->isVisible()) {
-        if (previousScissor) {
-            glScissor(previousRect[0], previousRect[1], previousRect[2], previousRect[3]);
-        } else {
-            glDisable(GL_SCISSOR_TEST);
-        }
+    stack.pop_back();
+    if (stack.empty()) {
+        glDisable(GL_SCISSOR_TEST);
+    } else {
+        applyScissor(stack.back());
     }
 }
 
-void ScrollLayer::scrollToTop() const {
+void ScrollLayer::scrollToTop() {
+    m_physics.stop();
     auto listTopScrollPos = -m_contentLayer->getContentHeight() + this->getContentHeight();
     m_contentLayer->setPositionY(listTopScrollPos);
 }
 
-void ScrollLayer::scrollTo(CCNode* node) const {
+void ScrollLayer::scrollTo(CCNode* node) {
     // check if node is in the content layer
-    if (node->getParent() != m_contentLayer) return;
+    auto parent = node->getParent();
+    while (parent && parent != m_contentLayer) {
+        parent = parent->getParent();
+    }
+    if (!parent) return;
 
     // calculate the position of the node
-    auto nodeOffset = m_contentLayer->getContentHeight() - node->getPositionY();
+    auto position = m_contentLayer->convertToNodeSpace(
+        node->getParent()->convertToWorldSpace(node->getPosition())
+    );
+    auto nodeOffset = m_contentLayer->getContentHeight() - position.y;
     auto top = -m_contentLayer->getContentHeight() + this->getContentHeight();
 
     // limit the position to the scrollable area
     auto pos = std::clamp(top + nodeOffset, -m_contentLayer->getContentHeight() + this->getContentHeight(), 0.0f);
 
+    m_physics.stop();
     m_contentLayer->setPositionY(pos);
 }
 
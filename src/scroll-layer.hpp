@@ -4,6 +4,20 @@
 #include <Geode/binding/CCMenuItemSpriteExtra.hpp>
 #include <Geode/binding/CCScrollLayerExt.hpp>
 #include <Geode/binding/CCScrollLayerExtDelegate.hpp>
+#include "scroll-physics.hpp"
+
+/// @brief Content layer that only visits the children overlapping the scroll view.
+/// Children without a size are treated as groups, and their own children are culled instead.
+class ScrollContentLayer final : public cocos2d::CCLayer {
+public:
+    static ScrollContentLayer* create(float width, float height);
+
+    void visit() override;
+
+protected:
+    /// @brief Draw the node and visit its children in z order, like CCNode::visit, skipping the ones outside the view.
+    static void visitChildren(CCNode* node, cocos2d::CCRect const& view);
+};
 
 // taken from Object Workshop (a hybrid of robtops cocos and geode)
 class ScrollLayer : public CCScrollLayerExt, public CCScrollLayerExtDelegate {
@@ -13,8 +27,16 @@ protected:
     cocos2d::CCPoint m_touchStartPosition2;
     cocos2d::CCPoint m_touchPosition2;
     bool m_touchMoved{};
-    float m_touchLastY{};
+    float m_touchLastY{};          // touch position along the scroll axis when the touch was last stolen
     bool m_cancellingTouches{};
+    ScrollPhysics m_physics;       // drag, fling and overscroll of the content layer
+
+    [[nodiscard]] bool isVertical() const;
+    /// @brief Update the physics with the current bounds and content position.
+    void syncPhysics();
+    /// @brief Move the content layer to the physics position.
+    void applyPhysics();
+    void update(float dt) override;
 
     void cancelAndStoleTouch(cocos2d::CCTouch*, cocos2d::CCEvent*);
     void checkBoundaryOfContent(float);
@@ -35,8 +57,8 @@ protected:
     ~ScrollLayer() override;
 
 public:
-    void scrollToTop() const;
-    void scrollTo(CCNode* node) const;
+    void scrollToTop();
+    void scrollTo(CCNode* node);
     static ScrollLayer* create(cocos2d::CCRect const& rect, bool scrollWheelEnabled = true, bool vertical = true);
     static ScrollLayer* create(cocos2d::CCSize const& size, bool scrollWheelEnabled = true, bool vertical = true);
 };
\ No newline at end of file
@@ -0,0 +1,186 @@
+#include "scroll-physics.hpp"
+#include <algorithm>
+#include <cmath>
+
+void ScrollPhysics::setBounds(double min, double max, double extent) {
+    m_min = std::min(min, max);
+    m_max = max;
+    m_extent = std::max(extent, 1.0);
+}
+
+void ScrollPhysics::setPosition(double position) {
+    m_dragPosition += position - m_position;
+    m_glideTarget += position - m_position;
+    m_position = position;
+    if (!m_dragging && (m_position < m_min || m_position > m_max)) {
+        m_moving = true;
+    }
+}
+
+void ScrollPhysics::stop() {
+    m_velocity = 0.0;
+    m_accumulator = 0.0;
+    m_dragging = false;
+    m_gliding = false;
+    m_moving = false;
+}
+
+void ScrollPhysics::beginDrag(double time) {
+    // catching the content stops it, and keeps the overscroll it had
+    m_velocity = 0.0;
+    m_accumulator = 0.0;
+    m_dragging = true;
+    m_gliding = false;
+    m_moving = false;
+
+    if (m_position > m_max) {
+        m_dragPosition = m_max + removeRubberBand(m_position - m_max);
+    } else if (m_position < m_min) {
+        m_dragPosition = m_min - removeRubberBand(m_min - m_position);
+    } else {
+        m_dragPosition = m_position;
+    }
+
+    m_sampleCount = 0;
+    m_sampleHead = 0;
+    m_samples[m_sampleHead] = { time, m_dragPosition };
+    m_sampleHead = (m_sampleHead + 1) % VelocitySamples;
+    m_sampleCount = 1;
+}
+
+void ScrollPhysics::drag(double delta, double time) {
+    if (!m_dragging) return;
+
+    m_dragPosition += delta;
+    if (m_dragPosition > m_max) {
+        m_position = m_max + applyRubberBand(m_dragPosition - m_max);
+    } else if (m_dragPosition < m_min) {
+        m_position = m_min - applyRubberBand(m_min - m_dragPosition);
+    } else {
+        m_position = m_dragPosition;
+    }
+
+    m_samples[m_sampleHead] = { time, m_dragPosition };
+    m_sampleHead = (m_sampleHead + 1) % VelocitySamples;
+    m_sampleCount = std::min(m_sampleCount + 1, VelocitySamples);
+}
+
+void ScrollPhysics::endDrag(double time) {
+    if (!m_dragging) return;
+
+    m_dragging = false;
+    m_velocity = std::clamp(sampleVelocity(time), -MaxVelocity, MaxVelocity);
+    m_accumulator = 0.0;
+    m_moving = std::abs(m_velocity) >= MinVelocity || m_position < m_min || m_position > m_max;
+}
+
+void ScrollPhysics::scrollBy(double delta, bool smooth) {
+    if (m_dragging) return;
+
+    auto from = m_gliding ? m_glideTarget : m_position;
+    auto target = std::clamp(from + delta, m_min, m_max);
+    m_velocity = 0.0;
+
+    if (!smooth) {
+        m_position = m_dragPosition = target;
+        m_gliding = false;
+        m_moving = false;
+        return;
+    }
+
+    m_glideTarget = target;
+    m_gliding = true;
+    m_moving = true;
+}
+
+double ScrollPhysics::applyRubberBand(double overscroll) const {
+    // approaches the view size, moves at RubberBand speed at first
+    return (1.0 - 1.0 / (overscroll * RubberBand / m_extent + 1.0)) * m_extent;
+}
+
+double ScrollPhysics::removeRubberBand(double distance) const {
+    distance = std::min(distance, m_extent * 0.99);
+    return distance * m_extent / ((m_extent - distance) * RubberBand);
+}
+
+double ScrollPhysics::sampleVelocity(double time) const {
+    if (m_sampleCount < 2) return 0.0;
+
+    // newest sample, and the oldest one still inside the window
+    auto newest = m_samples[(m_sampleHead + VelocitySamples - 1) % VelocitySamples];
+    if (time - newest.time > VelocityWindow) {
+        // the finger stopped before lifting
+        return 0.0;
+    }
+
+    auto oldest = newest;
+    for (size_t i = 2; i <= m_sampleCount; ++i) {
+        auto const& sample = m_samples[(m_sampleHead + VelocitySamples - i) % VelocitySamples];
+        if (newest.time - sample.time > VelocityWindow) break;
+        oldest = sample;
+    }
+
+    auto duration = newest.time - oldest.time;
+    if (duration <= 0.0) return 0.0;
+    return (newest.position - oldest.position) / duration;
+}
+
+bool ScrollPhysics::update(double dt) {
+    if (m_dragging || !m_moving) {
+        m_accumulator = 0.0;
+        return false;
+    }
+
+    m_accumulator += std::min(dt, MaxFrameTime);
+    while (m_accumulator >= Step && m_moving) {
+        this->step();
+        m_accumulator -= Step;
+    }
+
+    return true;
+}
+
+void ScrollPhysics::step() {
+    // exact decay over one step, the same at every frame rate
+    static double const decay = std::exp(-Friction * Step);
+    static double const glide = 1.0 - std::exp(-GlideRate * Step);
+
+    if (m_gliding) {
+        // the bounds might have changed since the scroll started
+        double target = std::clamp(m_glideTarget, m_min, m_max);
+        m_position += (target - m_position) * glide;
+        if (std::abs(target - m_position) < 0.5) {
+            m_position = target;
+            m_gliding = false;
+            m_moving = false;
+        }
+        m_dragPosition = m_position;
+        return;
+    }
+
+    double target = std::clamp(m_position, m_min, m_max);
+    double overscroll = m_position - target;
+
+    if (overscroll != 0.0) {
+        // critically damped spring back to the edge
+        double acceleration = -SpringRate * SpringRate * overscroll - 2.0 * SpringRate * m_velocity;
+        m_velocity += acceleration * Step;
+        m_position += m_velocity * Step;
+
+        // crossing the edge or getting close enough ends the bounce
+        if ((m_position - target) * overscroll <= 0.0 || (std::abs(m_position - target) < 0.5 && std::abs(m_velocity) < MinVelocity)) {
+            m_position = target;
+            m_velocity = 0.0;
+            m_moving = false;
+        }
+    } else {
+        m_velocity *= decay;
+        m_position += m_velocity * Step;
+        if (std::abs(m_velocity) < MinVelocity) {
+            m_velocity = 0.0;
+            m_moving = std::clamp(m_position, m_min, m_max) != m_position;
+        }
+    }
+
+    m_dragPosition = m_position;
+}
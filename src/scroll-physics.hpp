@@ -0,0 +1,78 @@
+#pragma once
+#include <array>
+#include <cstddef>
+
+// Kinetic scrolling along one axis. Free of cocos2d and Geode like text.hpp, so it can run on the host.
+// Time is integrated in fixed steps, so the motion is the same at any frame rate,
+// and replaying the same input always gives the same positions.
+
+class ScrollPhysics {
+public:
+    static constexpr double Step = 1.0 / 240.0;        // integration step, in seconds
+    static constexpr double MaxFrameTime = 0.25;       // longer frames are cut, so a spike doesn't run hundreds of steps
+    static constexpr size_t VelocitySamples = 6;       // touch events kept to estimate the release velocity
+    static constexpr double VelocityWindow = 0.1;      // samples older than this (seconds) are ignored on release
+    static constexpr double Friction = 3.5;            // velocity decays by exp(-Friction * t)
+    static constexpr double MinVelocity = 8.0;         // points per second, slower motion stops
+    static constexpr double MaxVelocity = 6000.0;      // points per second, caps very fast flicks
+    static constexpr double RubberBand = 0.55;         // overscroll resistance while dragging, lower is stiffer
+    static constexpr double SpringRate = 14.0;         // how fast the overscroll returns after release (critically damped)
+    static constexpr double GlideRate = 18.0;          // smooth scrolling covers 1 - exp(-GlideRate * t) of the distance left
+
+    /// @brief Set the allowed range of the position, and the size of the view (used to limit the overscroll).
+    void setBounds(double min, double max, double extent);
+    /// @brief Move to a position, keeping the current motion.
+    void setPosition(double position);
+    /// @brief Stop any motion and the drag.
+    void stop();
+
+    /// @brief Start following a touch, at time in seconds (any monotonic clock).
+    void beginDrag(double time);
+    /// @brief Move the touch by delta. Past the bounds the position only follows with resistance.
+    void drag(double delta, double time);
+    /// @brief Release the touch and fling with the velocity of the last samples.
+    void endDrag(double time);
+
+    /// @brief Scroll by a distance, staying inside the bounds. Smooth scrolling glides there over a few frames,
+    /// and further calls add to the distance that is left instead of restarting from the current position.
+    void scrollBy(double delta, bool smooth);
+
+    /// @brief Advance the simulation by a frame of any length. Returns true while the position is changing.
+    bool update(double dt);
+
+    [[nodiscard]] double getPosition() const { return m_position; }
+    [[nodiscard]] double getVelocity() const { return m_velocity; }
+    [[nodiscard]] bool isDragging() const { return m_dragging; }
+    [[nodiscard]] bool isMoving() const { return m_moving; }
+
+protected:
+    struct Sample {
+        double time;
+        double position; // unclamped drag position
+    };
+
+    /// @brief Advance by one fixed step.
+    void step();
+    /// @brief Distance shown for an overscroll of the given length while dragging.
+    [[nodiscard]] double applyRubberBand(double overscroll) const;
+    /// @brief Overscroll that is shown at the given distance, the inverse of applyRubberBand.
+    [[nodiscard]] double removeRubberBand(double distance) const;
+    /// @brief Velocity of the drag over the recent samples.
+    [[nodiscard]] double sampleVelocity(double time) const;
+
+protected:
+    std::array<Sample, VelocitySamples> m_samples{};
+    size_t m_sampleCount = 0;     // valid samples
+    size_t m_sampleHead = 0;      // index of the next sample to write
+    double m_position = 0.0;
+    double m_velocity = 0.0;      // points per second
+    double m_min = 0.0;
+    double m_max = 0.0;
+    double m_extent = 1.0;        // view size along the axis
+    double m_dragPosition = 0.0;  // where the content would be without the rubber band
+    double m_accumulator = 0.0;   // time not simulated yet
+    double m_glideTarget = 0.0;   // where smooth scrolling is heading
+    bool m_gliding = false;
+    bool m_dragging = false;
+    bool m_moving = false;
+};
@@ -0,0 +1,513 @@
+#include "text-layout.hpp"
+#include <algorithm>
+
+std::span<const LayoutGlyph> TextLayout::getLine(size_t index) const {
+    auto begin = lines[index];
+    auto end = index + 1 < lines.size() ? lines[index + 1] : static_cast<uint32_t>(glyphs.size());
+    return std::span(glyphs).subspan(begin, end - begin);
+}
+
+void TextLayout::clear() {
+    glyphs.clear();
+    lines.clear();
+    runs.clear();
+    lastDef = nullptr;
+    width = 0.f;
+    height = 0.f;
+}
+
+void layoutText(std::u32string_view text, LayoutContext const& context, LayoutOptions const& options, TextLayout& out) {
+    out.clear();
+    if (text.empty() || context.fonts.empty()) {
+        return;
+    }
+
+    layout::tokenize(text, options, out);
+    layout::shape(text, context, options, out);
+    layout::breakLines(context, options, out);
+    layout::align(options, out);
+}
+
+LayoutSize measureText(
+    std::u32string_view text, LayoutContext const& context, LayoutOptions const& options,
+    TextLayout& scratch, std::vector<float>* lineWidths
+) {
+    scratch.clear();
+    if (text.empty() || context.fonts.empty()) {
+        return {};
+    }
+
+    layout::tokenize(text, options, scratch);
+    layout::shape(text, context, options, scratch);
+    return layout::measureLines(context, options, scratch, lineWidths);
+}
+
+void layout::tokenize(std::u32string_view text, LayoutOptions const& options, TextLayout& out) {
+    auto& runs = out.runs;
+    auto stringLen = static_cast<uint32_t>(text.size());
+
+    if (!options.wrap) {
+        // every line is a single run
+        uint32_t lineStart = 0;
+        for (uint32_t i = 0; i < stringLen; ++i) {
+            if (text[i] == '\n') {
+                runs.push_back({ .begin = lineStart, .end = i, .lineEnd = true });
+                lineStart = i + 1;
+            }
+        }
+        runs.push_back({ .begin = lineStart, .end = stringLen, .lineEnd = true });
+        return;
+    }
+
+    // split the text into lines and words
+    uint32_t wordStart = 0;
+    bool hasWords = false;
+    for (uint32_t i = 0; i < stringLen; ++i) {
+        if (text[i] == ' ') {
+            runs.push_back({ .begin = wordStart, .end = i });
+            hasWords = true;
+            wordStart = i + 1;
+            continue;
+        }
+
+        // check if we should break the word
+        if (text[i] == '\n') {
+            runs.push_back({ .begin = wordStart, .end = i, .lineEnd = true });
+            hasWords = false;
+            wordStart = i + 1;
+        } else if (i == stringLen - 1) {
+            runs.push_back({ .begin = wordStart, .end = i + 1, .lineEnd = true });
+            hasWords = false;
+        } else if (options.breakWords > 0 && i - wordStart >= static_cast<uint32_t>(options.breakWords)) {
+            runs.push_back({ .begin = wordStart, .end = i });
+            hasWords = true;
+            wordStart = i;
+        }
+    }
+    if (hasWords) {
+        runs.back().lineEnd = true;
+    }
+}
+
+/// @brief Scale of a fallback font glyph, so that it matches the primary font.
+static float getFallbackScale(LayoutFont const& font, const BMFontConfiguration* primary) {
+    if (font.scale.has_value()) {
+        // manual font scale
+        return font.scale.value();
+    }
+    // auto calculated scale
+    return primary->getCommonHeight() / font.config->getCommonHeight();
+}
+
+/// @brief Find the character in the primary font, or its uppercase version if only that one exists.
+static const BMFontDef* findPrimaryDef(char32_t c, std::unordered_map<uint32_t, BMFontDef> const& mainCharset) {
+    auto it = mainCharset.find(c);
+    if (it != mainCharset.end()) {
+        return &it->second;
+    }
+
+    // check for uppercase version of the character
+    if (c >= 'a' && c <= 'z') {
+        it = mainCharset.find(c - 'a' + 'A');
+        if (it != mainCharset.end()) {
+            return &it->second;
+        }
+    }
+
+    return nullptr;
+}
+
+FontFallbackIndex::FontFallbackIndex(std::span<const LayoutFont> fonts) {
+    if (fonts.size() < 2) {
+        return;
+    }
+
+    auto primary = fonts.front().config;
+    auto& mainCharset = primary->getFontDefDictionary();
+    for (size_t i = 1; i < fonts.size(); ++i) {
+        auto scale = getFallbackScale(fonts[i], primary);
+        for (auto& [c, def] : fonts[i].config->getFontDefDictionary()) {
+            if (findPrimaryDef(c, mainCharset)) {
+                continue;
+            }
+            // earlier fonts take priority
+            m_entries.try_emplace(c, Entry{ &def, scale, static_cast<uint8_t>(i) });
+        }
+    }
+}
+
+static const BMFontDef* getFontDefForChar(
+    char32_t c, LayoutContext const& context, float& outScale, uint8_t& outIndex
+) {
+    auto fonts = context.fonts;
+    auto primary = fonts.front().config;
+    if (auto def = findPrimaryDef(c, primary->getFontDefDictionary())) {
+        return def;
+    }
+
+    if (fonts.size() < 2) {
+        return nullptr;
+    }
+
+    if (context.fallbacks) {
+        auto entry = context.fallbacks->find(c);
+        if (!entry) {
+            return nullptr;
+        }
+        outScale = entry->scale;
+        outIndex = entry->font;
+        return entry->def;
+    }
+
+    // check other fonts
+    for (size_t i = 1; i < fonts.size(); ++i) {
+        auto& charset = fonts[i].config->getFontDefDictionary();
+        auto it = charset.find(c);
+        if (it != charset.end()) {
+            outScale = getFallbackScale(fonts[i], primary);
+            outIndex = static_cast<uint8_t>(i);
+            return &it->second;
+        }
+    }
+
+    return nullptr;
+}
+
+/// @brief Parse an emoji or custom node at the index and add it as a glyph.
+static void checkForEmoji(
+    std::u32string_view text, uint32_t& index, float commonHeight, float& nextX,
+    LayoutContext const& context, LayoutOptions const& options, TextLayout& out
+) {
+    if (!context.emojis || !context.delegate) {
+        return;
+    }
+
+    auto decodedEmoji = parseEmoji(text, index, context.emojis);
+    if (decodedEmoji.empty()) {
+        return;
+    }
+
+    LayoutGlyph glyph;
+    LayoutMetrics metrics;
+    if (auto it = context.emojis->find(decodedEmoji); it != context.emojis->end()) {
+        if (!context.delegate->measureEmoji(it->second, commonHeight, metrics)) {
+            return;
+        }
+        glyph.type = LayoutGlyphType::Emoji;
+        glyph.font = it->second.page;
+    } else if (context.delegate->measureCustom(decodedEmoji, text, index, commonHeight, metrics)) {
+        glyph.type = LayoutGlyphType::Custom;
+    } else {
+        return;
+    }
+
+    auto scaleFactor = options.scaleFactor;
+    glyph.handle = metrics.handle;
+    glyph.scale = metrics.scale;
+    glyph.width = metrics.width / scaleFactor;
+    glyph.x = (nextX + metrics.width * .5f) / scaleFactor;
+    glyph.y = commonHeight * .5f / scaleFactor;
+    out.glyphs.push_back(glyph);
+
+    nextX += metrics.width + options.extraKerning;
+}
+
+void layout::shape(std::u32string_view text, LayoutContext const& context, LayoutOptions const& options, TextLayout& out) {
+    auto primary = context.fonts.front().config;
+    auto commonHeight = primary->getCommonHeight();
+    auto scaleFactor = options.scaleFactor;
+
+    out.glyphs.reserve(text.size());
+
+    for (auto& run : out.runs) {
+        auto word = text.substr(run.begin, run.end - run.begin);
+        auto wordLen = static_cast<uint32_t>(word.size());
+        char32_t prevChar = -1;
+        float nextX = 0;
+
+        run.glyphBegin = static_cast<uint32_t>(out.glyphs.size());
+
+        for (uint32_t k = 0; k < wordLen; ++k) {
+            auto c = word[k];
+            if (c == ' ' && options.wrap) {
+                continue;
+            }
+
+            if (context.emojis && shouldParseDigitRegionalIndicator(word.substr(k))) {
+                checkForEmoji(word, k, commonHeight, nextX, context, options, out);
+                run.extent = std::max(run.extent, nextX);
+                continue;
+            }
+
+            // find the font definition for the character
+            float scale = 1.f;
+            uint8_t fontIndex = 0;
+            auto fontDef = getFontDefForChar(c, context, scale, fontIndex);
+            out.lastDef = fontDef;
+            if (!fontDef) {
+                checkForEmoji(word, k, commonHeight, nextX, context, options, out);
+                run.extent = std::max(run.extent, nextX);
+                continue;
+            }
+
+            auto config = context.fonts[fontIndex].config;
+            auto kerningAmount = config->kerningAmountForChars(prevChar, c) * scale;
+
+            float yOffset = commonHeight - fontDef->yOffset * scale;
+            out.glyphs.push_back({
+                .type = LayoutGlyphType::Character,
+                .font = fontIndex,
+                .def = fontDef,
+                .x = (nextX + fontDef->xOffset * scale + fontDef->rect.width * 0.5f * scale + kerningAmount) / scaleFactor,
+                .y = (yOffset - fontDef->rect.height * scale * 0.5f) / scaleFactor,
+                .width = fontDef->rect.width / scaleFactor * scale,
+                .scale = scale
+            });
+
+            // update kerning
+            nextX += options.extraKerning + fontDef->xAdvance * scale + kerningAmount;
+            prevChar = c;
+
+            run.extent = std::max(run.extent, nextX);
+        }
+
+        run.glyphEnd = static_cast<uint32_t>(out.glyphs.size());
+        run.advance = nextX;
+    }
+}
+
+static void breakLinesSimple(LayoutContext const& context, LayoutOptions const& options, TextLayout& out) {
+    auto primary = context.fonts.front().config;
+    auto commonHeight = primary->getCommonHeight();
+    auto lineHeight = commonHeight + options.extraLineSpacing;
+    auto scaleFactor = options.scaleFactor;
+    auto lines = out.runs.size();
+
+    float longestLine = 0;
+    float nextY = lineHeight * lines - lineHeight;
+    for (auto& run : out.runs) {
+        out.lines.push_back(run.glyphBegin);
+        for (auto i = run.glyphBegin; i < run.glyphEnd; ++i) {
+            out.glyphs[i].y += nextY / scaleFactor;
+        }
+        longestLine = std::max(longestLine, run.extent);
+        nextY -= lineHeight;
+    }
+
+    float width = longestLine;
+    auto fontDef = out.lastDef;
+    if (fontDef && fontDef->xAdvance < fontDef->rect.width) {
+        width += fontDef->rect.width - fontDef->xAdvance;
+    }
+
+    out.width = width / scaleFactor;
+    out.height = (commonHeight * lines + options.extraLineSpacing * (lines - 1)) / scaleFactor;
+}
+
+static void breakLinesWrapped(LayoutContext const& context, LayoutOptions const& options, TextLayout& out) {
+    auto primary = context.fonts.front().config;
+    auto commonHeight = primary->getCommonHeight();
+    auto lineHeight = commonHeight + options.extraLineSpacing;
+    auto scaleFactor = options.scaleFactor;
+
+    auto& spaceDef = primary->getFontDefDictionary().at(' ');
+    auto spaceWidth = (options.extraKerning + spaceDef.xAdvance) / scaleFactor;
+
+    // start wrapping the lines
+    float nextX = 0;
+    auto maxWidth = options.wrapWidth;
+    out.lines.push_back(0);
+    for (size_t i = 0; i < out.runs.size(); ++i) {
+        auto& word = out.runs[i];
+        auto wordWidth = word.advance / scaleFactor;
+
+        if (nextX + wordWidth > maxWidth) {
+            // wrap the line
+            out.lines.push_back(word.glyphBegin);
+            nextX = 0;
+        }
+
+        if (word.glyphBegin != word.glyphEnd) {
+            // add the word to the line
+            auto& front = out.glyphs[word.glyphBegin];
+            float startX = front.x - front.width * 0.5f;
+            for (auto k = word.glyphBegin; k < word.glyphEnd; ++k) {
+                out.glyphs[k].x += nextX - startX;
+            }
+            nextX += wordWidth;
+        }
+
+        // append space
+        nextX += spaceWidth;
+
+        if (word.lineEnd && i + 1 < out.runs.size()) {
+            out.lines.push_back(word.glyphEnd);
+            nextX = 0;
+        }
+    }
+
+    // recalculate Y positions
+    auto lines = out.lines.size();
+    float commonHeightScaled = (lines <= 1 ? commonHeight : lineHeight) / scaleFactor;
+    float nextY = commonHeightScaled * lines - commonHeightScaled;
+    float maxLineWidth = 0;
+    for (size_t i = 0; i < lines; ++i) {
+        auto begin = out.lines[i];
+        auto end = i + 1 < lines ? out.lines[i + 1] : static_cast<uint32_t>(out.glyphs.size());
+        for (auto k = begin; k < end; ++k) {
+            auto& glyph = out.glyphs[k];
+            glyph.y += nextY;
+            maxLineWidth = std::max(maxLineWidth, glyph.x + glyph.width);
+        }
+        nextY -= commonHeightScaled;
+    }
+
+    out.width = maxLineWidth;
+    out.height = lineHeight * lines / scaleFactor;
+}
+
+void layout::breakLines(LayoutContext const& context, LayoutOptions const& options, TextLayout& out) {
+    if (options.wrap) {
+        breakLinesWrapped(context, options, out);
+    } else {
+        breakLinesSimple(context, options, out);
+    }
+}
+
+LayoutSize layout::measureLines(
+    LayoutContext const& context, LayoutOptions const& options, TextLayout const& layout,
+    std::vector<float>* lineWidths
+) {
+    auto primary = context.fonts.front().config;
+    auto commonHeight = primary->getCommonHeight();
+    auto lineHeight = commonHeight + options.extraLineSpacing;
+    auto scaleFactor = options.scaleFactor;
+
+    if (!options.wrap) {
+        // same as breakLinesSimple
+        size_t lines = layout.runs.size();
+        float longestLine = 0;
+        for (auto& run : layout.runs) {
+            longestLine = std::max(longestLine, run.extent);
+            if (lineWidths) lineWidths->push_back(run.extent / scaleFactor);
+        }
+
+        auto fontDef = layout.lastDef;
+        if (fontDef && fontDef->xAdvance < fontDef->rect.width) {
+            longestLine += fontDef->rect.width - fontDef->xAdvance;
+        }
+
+        return {
+            longestLine / scaleFactor,
+            (commonHeight * lines + options.extraLineSpacing * (lines - 1)) / scaleFactor,
+            lines
+        };
+    }
+
+    // same as breakLinesWrapped, only tracking the line count and the widest line
+    auto& spaceDef = primary->getFontDefDictionary().at(' ');
+    auto spaceWidth = (options.extraKerning + spaceDef.xAdvance) / scaleFactor;
+
+    float nextX = 0;
+    float maxLineWidth = 0;
+    float lineWidth = 0;
+    size_t lines = 1;
+    auto endLine = [&] {
+        if (lineWidths) lineWidths->push_back(lineWidth);
+        lineWidth = 0;
+        ++lines;
+        nextX = 0;
+    };
+
+    for (size_t i = 0; i < layout.runs.size(); ++i) {
+        auto& word = layout.runs[i];
+        auto wordWidth = word.advance / scaleFactor;
+
+        if (nextX + wordWidth > options.wrapWidth) {
+            endLine();
+        }
+
+        if (word.glyphBegin != word.glyphEnd) {
+            auto& front = layout.glyphs[word.glyphBegin];
+            float startX = front.x - front.width * 0.5f;
+            for (auto k = word.glyphBegin; k < word.glyphEnd; ++k) {
+                auto& glyph = layout.glyphs[k];
+                lineWidth = std::max(lineWidth, glyph.x + (nextX - startX) + glyph.width);
+            }
+            maxLineWidth = std::max(maxLineWidth, lineWidth);
+            nextX += wordWidth;
+        }
+
+        nextX += spaceWidth;
+
+        if (word.lineEnd && i + 1 < layout.runs.size()) {
+            endLine();
+        }
+    }
+    if (lineWidths) lineWidths->push_back(lineWidth);
+
+    return { maxLineWidth, lineHeight * lines / scaleFactor, lines };
+}
+
+float layout::fitScale(
+    LayoutContext const& context, LayoutOptions options, TextLayout const& layout,
+    float width, float height, float minScale
+) {
+    constexpr int Iterations = 8;        // precision of 1/256 of the scale range
+    constexpr float Tolerance = 0.01f;   // rounding errors when comparing sizes
+
+    auto fits = [&](float scale) {
+        options.wrapWidth = width / scale;
+        auto size = measureLines(context, options, layout);
+        return size.width * scale <= width + Tolerance && size.height * scale <= height + Tolerance;
+    };
+
+    if (fits(1.f)) return 1.f;
+    if (minScale >= 1.f || !fits(minScale)) return minScale;
+
+    // lower bound always fits, upper bound never does
+    float low = minScale, high = 1.f;
+    for (int i = 0; i < Iterations; ++i) {
+        auto mid = (low + high) * 0.5f;
+        (fits(mid) ? low : high) = mid;
+    }
+    return low;
+}
+
+void layout::align(LayoutOptions const& options, TextLayout& out) {
+    if ((options.alignment == BMFontAlignment::Left || out.lines.size() < 2) && !options.wrap) {
+        return;
+    }
+
+    auto contentWidth = out.width;
+
+    for (size_t i = 0; i < out.lines.size(); ++i) {
+        auto begin = out.lines[i];
+        auto end = i + 1 < out.lines.size() ? out.lines[i + 1] : static_cast<uint32_t>(out.glyphs.size());
+        if (begin == end) {
+            continue;
+        }
+
+        auto& first = out.glyphs[begin];
+        auto& last = out.glyphs[end - 1];
+
+        float offset = 0;
+        if (options.alignment == BMFontAlignment::Right) {
+            offset = contentWidth - last.x - last.width * 0.5f;
+        } else if (options.alignment == BMFontAlignment::Center) {
+            auto endPos = last.x + last.width * 0.5f;
+            auto startPos = first.x - first.width * 0.5f;
+            offset = (contentWidth - endPos + startPos) * 0.5f;
+        } else if (options.alignment == BMFontAlignment::Justify) {
+            // TODO: justify
+        }
+
+        if (offset == 0.f) {
+            continue;
+        }
+
+        for (auto k = begin; k < end; ++k) {
+            out.glyphs[k].x += offset;
+        }
+    }
+}
@@ -0,0 +1,173 @@
+#pragma once
+#include "bmfont.hpp"
+#include "text.hpp"
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <span>
+#include <unordered_map>
+#include <vector>
+
+// Layout core of the label. Computes glyph positions without touching any nodes,
+// so it can be used for measuring text and in headless builds (see bench/).
+
+enum class BMFontAlignment {
+    Left,
+    Center,
+    Right,
+    Justify // TODO: implement justify
+};
+
+/// @brief Font used by the layout. The first font is the primary one, the rest are fallbacks.
+struct LayoutFont {
+    const BMFontConfiguration* config = nullptr; // font configuration
+    std::optional<float> scale;                  // auto scale by default
+};
+
+/// @brief Characters the primary font is missing, merged from all fallback fonts.
+/// Built once per font set, so that a fallback character takes a single lookup.
+class FontFallbackIndex {
+public:
+    struct Entry {
+        const BMFontDef* def = nullptr; // font definition of the character
+        float scale = 1.f;              // glyph scale to match the primary font
+        uint8_t font = 0;               // index of the fallback font
+    };
+
+    FontFallbackIndex() = default;
+    /// @brief Index the fallbacks of a font set. The first font is the primary one and is not indexed.
+    explicit FontFallbackIndex(std::span<const LayoutFont> fonts);
+
+    /// @brief Get the fallback glyph of a character, or nullptr if no font has it.
+    [[nodiscard]] const Entry* find(char32_t c) const {
+        auto it = m_entries.find(c);
+        return it == m_entries.end() ? nullptr : &it->second;
+    }
+    [[nodiscard]] size_t size() const { return m_entries.size(); }
+
+private:
+    std::unordered_map<uint32_t, Entry> m_entries;
+};
+
+/// @brief Size of an emoji or custom node, scaled to match the font height.
+struct LayoutMetrics {
+    float width = 0.f;      // width in pixels after scaling
+    float scale = 1.f;      // node scale
+    void* handle = nullptr; // delegate data, passed through to the glyph
+};
+
+/// @brief Measures nodes that are not part of a font.
+class LayoutDelegate {
+public:
+    virtual ~LayoutDelegate() = default;
+
+    /// @brief Measure an emoji from the emoji map. Return false to skip it.
+    virtual bool measureEmoji(EmojiFrame const& emoji, float commonHeight, LayoutMetrics& out) = 0;
+
+    /// @brief Measure a custom node for a sequence that is not in the emoji map. Return false to skip it.
+    /// The index points to the last character of the sequence and can be moved to consume more characters.
+    virtual bool measureCustom(
+        std::u32string_view sequence, std::u32string_view text, uint32_t& index,
+        float commonHeight, LayoutMetrics& out
+    ) = 0;
+};
+
+enum class LayoutGlyphType : uint8_t {
+    Character,
+    Emoji,
+    Custom
+};
+
+struct LayoutGlyph {
+    LayoutGlyphType type = LayoutGlyphType::Character;
+    uint8_t font = 0;               // font index for characters, page for emojis
+    const BMFontDef* def = nullptr; // font definition (characters only)
+    void* handle = nullptr;         // delegate data (emojis and custom nodes only)
+    float x = 0.f;                  // center position in points
+    float y = 0.f;                  // center position in points
+    float width = 0.f;              // scaled width in points
+    float scale = 1.f;              // node scale
+};
+
+/// @brief Word (or whole line, when not wrapping) that is shaped as one piece. [Internal]
+struct LayoutRun {
+    uint32_t begin = 0;      // first character in the text
+    uint32_t end = 0;        // one past the last character in the text
+    uint32_t glyphBegin = 0; // first glyph of the run
+    uint32_t glyphEnd = 0;   // one past the last glyph of the run
+    float advance = 0.f;     // pen position after the run, in pixels
+    float extent = 0.f;      // furthest pen position within the run, in pixels
+    bool lineEnd = false;    // whether the run ends a line of the source text
+};
+
+struct LayoutOptions {
+    float scaleFactor = 1.f;                           // content scale factor
+    float extraKerning = 0.f;                          // additional kerning between characters
+    float extraLineSpacing = 0.f;                      // additional spacing between lines
+    bool wrap = false;                                 // enable line wrapping
+    float wrapWidth = 0.f;                             // maximum line width in points
+    int breakWords = -1;                               // break words by N chars groups (-1 = no break)
+    BMFontAlignment alignment = BMFontAlignment::Left; // text alignment
+};
+
+/// @brief Result of a layout. Can be reused between calls to avoid allocations.
+struct TextLayout {
+    std::vector<LayoutGlyph> glyphs;    // all glyphs, in text order
+    std::vector<uint32_t> lines;        // index of the first glyph of each line
+    std::vector<LayoutRun> runs;        // runs from the last layout [Internal]
+    const BMFontDef* lastDef = nullptr; // last looked up font definition [Internal]
+    float width = 0.f;                  // content width in points
+    float height = 0.f;                 // content height in points
+
+    [[nodiscard]] size_t getLineCount() const { return lines.size(); }
+    [[nodiscard]] std::span<const LayoutGlyph> getLine(size_t index) const;
+    void clear();
+};
+
+/// @brief Size of a layout, without the glyph positions.
+struct LayoutSize {
+    float width = 0.f;  // content width in points
+    float height = 0.f; // content height in points
+    size_t lines = 0;   // amount of lines
+};
+
+struct LayoutContext {
+    std::span<const LayoutFont> fonts;            // must contain at least the primary font
+    const EmojiMap* emojis = nullptr;             // emojis are disabled if null
+    LayoutDelegate* delegate = nullptr;           // emojis and custom nodes are skipped if null
+    const FontFallbackIndex* fallbacks = nullptr; // merged fallback fonts, probed one by one if null
+};
+
+/// @brief Lay out the text. Runs all the stages below in order.
+void layoutText(std::u32string_view text, LayoutContext const& context, LayoutOptions const& options, TextLayout& out);
+
+/// @brief Compute the size layoutText would produce, without placing any glyph. Runs tokenize, shape and measureLines,
+/// using scratch for the runs. If lineWidths is given, the width of every line is appended to it.
+LayoutSize measureText(
+    std::u32string_view text, LayoutContext const& context, LayoutOptions const& options,
+    TextLayout& scratch, std::vector<float>* lineWidths = nullptr
+);
+
+namespace layout {
+    /// @brief Split the text into runs (words when wrapping, lines otherwise).
+    void tokenize(std::u32string_view text, LayoutOptions const& options, TextLayout& out);
+    /// @brief Look up glyphs of every run and place them relative to the start of the run.
+    void shape(std::u32string_view text, LayoutContext const& context, LayoutOptions const& options, TextLayout& out);
+    /// @brief Place runs onto lines, wrapping them if needed, and compute the content size.
+    void breakLines(LayoutContext const& context, LayoutOptions const& options, TextLayout& out);
+    /// @brief Shift lines according to the alignment.
+    void align(LayoutOptions const& options, TextLayout& out);
+    /// @brief Compute the size breakLines would produce, without moving any glyph.
+    /// Only needs tokenize and shape, so it can be repeated with different wrap widths.
+    /// If lineWidths is given, the width of every line is appended to it.
+    LayoutSize measureLines(
+        LayoutContext const& context, LayoutOptions const& options, TextLayout const& layout,
+        std::vector<float>* lineWidths = nullptr
+    );
+    /// @brief Find the largest scale (at most 1, at least minScale) at which the text fits in the box,
+    /// with the wrap width widened to match. Binary search over measureLines, needs tokenize and shape.
+    float fitScale(
+        LayoutContext const& context, LayoutOptions options, TextLayout const& layout,
+        float width, float height, float minScale
+    );
+}
@@ -0,0 +1,56 @@
+#include "text.hpp"
+#include <simdutf.h>
+
+std::u32string utf8_to_utf32(std::string_view text) {
+    size_t length = simdutf::utf32_length_from_utf8(text.data(), text.size());
+    std::u32string result(length, 0);
+    (void) simdutf::convert_utf8_to_utf32(text.data(), text.size(), result.data());
+    return result;
+}
+
+std::string utf32_to_utf8(std::u32string_view text) {
+    size_t length = simdutf::utf8_length_from_utf32(text.data(), text.size());
+    std::string result(length, 0);
+    (void) simdutf::convert_utf32_to_utf8(text.data(), text.size(), result.data());
+    return result;
+}
+
+std::u32string_view parseEmoji(std::u32string_view text, uint32_t& index, const EmojiMap* emojis) {
+    size_t emojiStart = index;
+    size_t i = index;
+
+    if (i >= text.size() || !(isEmoji(text[i])
+                              || isRegionalIndicator(text[i])
+                              || shouldParseDigitRegionalIndicator(text.substr(i)))
+    ) {
+        return {}; // not an emoji
+    }
+
+    // handle regional indicators
+    if (isRegionalIndicator(text[i])) {
+        // if the next character is also a regional indicator, check if we have it defined in the emoji map
+        if (i + 1 < text.size() && isRegionalIndicator(text[i + 1]) && emojis && emojis->contains(text.substr(i, 2))) {
+            ++i;
+        }
+    } else if (shouldParseDigitRegionalIndicator(text.substr(emojiStart))) {
+        i += 2;
+    } else {
+        // Parse the emoji components
+        while (i + 1 < text.size()) {
+            // handle skin tone modifiers
+            if (isSkinToneModifier(text[i + 1]) || isVariationSelector(text[i + 1])) {
+                ++i;
+            } else if (isZeroWidthJoiner(text[i + 1])) {
+                ++i;
+                if (i + 1 < text.size() && isEmoji(text[i + 1])) {
+                    ++i;
+                }
+            } else {
+                break;
+            }
+        }
+    }
+
+    index = i; // Update index to the end of the parsed emoji
+    return text.substr(emojiStart, i - emojiStart + 1);
+}
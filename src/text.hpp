@@ -0,0 +1,71 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+
+// Text utilities shared by the label and the emoji tables.
+// This header must not depend on cocos2d or Geode, so it can be used in headless builds.
+
+std::u32string utf8_to_utf32(std::string_view text);
+std::string utf32_to_utf8(std::u32string_view text);
+
+inline void findAndReplace(std::string& str, std::string_view find, std::string_view replace) {
+    size_t pos = 0;
+    while ((pos = str.find(find, pos)) != std::string::npos) {
+        str.replace(pos, find.length(), replace);
+        pos += replace.length();
+    }
+}
+
+/// @brief Sprite frame of an emoji and the spritesheet page it is located on.
+struct EmojiFrame {
+    const char* name = nullptr;
+    uint8_t page = 0;
+};
+
+using EmojiMap = std::unordered_map<std::u32string_view, EmojiFrame>;
+
+constexpr bool isRegionalIndicator(char32_t c) {
+    return c >= 0x1F1E6 && c <= 0x1F1FF;
+}
+
+constexpr bool isEmoji(char32_t c) {
+    return (c >= 0x1F300 && c <= 0x1F6FF)    // Emoticons, transport, weather
+           || (c >= 0x2600 && c <= 0x27BF)   // Miscellaneous Symbols and Dingbats
+           || (c >= 0x2000 && c <= 0x23FF)   // General Punctuation, Super/subscripts, Diacritical marks, etc.
+           || (c >= 0x2B50 && c <= 0x2B55)   // Star emojis
+           || (c >= 0x1F900 && c <= 0x1F9FF) // Supplemental Symbols and Pictographs
+           || (c >= 0x1F700 && c <= 0x1F7FF) // Alchemical Symbols
+           || (c >= 0x1FA00 && c <= 0x1FAFF) // Symbols and Pictographs Extended-A
+           || (c >= 0x1F000 && c <= 0x1F02F) // Mahjong, Domino
+           || (c >= 0xE0020 && c <= 0xE007F) // Tags for flags
+           || (c >= 0x1C000 && c <= 0x1CFFF) // Custom range for special emojis
+           || c == 0x20E3;                   // Combining enclosing keycap
+}
+
+constexpr bool isSkinToneModifier(char32_t c) {
+    return c >= 0x1F3FB && c <= 0x1F3FF;
+}
+
+constexpr bool isZeroWidthJoiner(char32_t c) {
+    return c == 0x200D;
+}
+
+constexpr bool isVariationSelector(char32_t c) {
+    return c >= 0xFE00 && c <= 0xFE0F;
+}
+
+constexpr bool isDigit(char32_t c) {
+    return c <= 0x0039 && c >= 0x0030;
+}
+
+constexpr bool shouldParseDigitRegionalIndicator(std::u32string_view text) {
+    return isDigit(text[0]) && text.size() > 2 && text[2] == 0x20E3 && isVariationSelector(text[1]);
+}
+
+/// @brief Parse an emoji sequence starting at index. On success, index is moved to the last character of the sequence.
+/// Regional indicator pairs are only joined if the pair exists in the emoji map.
+/// @return The emoji sequence, or an empty view if there is no emoji at the index.
+std::u32string_view parseEmoji(std::u32string_view text, uint32_t& index, const EmojiMap* emojis);
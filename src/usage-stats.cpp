@@ -0,0 +1,126 @@
+#include "usage-stats.hpp"
+#include <Geode/loader/Mod.hpp>
+#include <algorithm>
+#include <cmath>
+#include <map>
+
+// decay rate per use, in log space
+static constexpr double DecayRate = 0.69314718055994530942 / UsageStats::HalfLife;
+
+UsageStats& UsageStats::get() {
+    static UsageStats instance;
+    return instance;
+}
+
+UsageStats::UsageStats() {
+    auto mod = geode::Mod::get();
+    m_clock = mod->getSavedValue<uint64_t>("emoji-usage-clock", 0);
+
+    auto saved = mod->getSavedValue<std::map<std::string, double>>("emoji-usage", {});
+    if (saved.empty()) {
+        // migrate lifetime counters, treating them as all used right now
+        auto legacy = mod->getSavedValue<std::map<std::string, uint64_t>>("frequently-used-emojis", {});
+        auto now = m_clock * DecayRate;
+        for (auto& [emoji, count] : legacy) {
+            if (count > 0) saved.emplace(emoji, now + std::log(static_cast<double>(count)));
+        }
+        m_dirty = !legacy.empty();
+    }
+
+    m_ranking.reserve(saved.size());
+    for (auto& [emoji, key] : saved) {
+        m_ranking.push_back({ emoji, key });
+    }
+
+    std::ranges::stable_sort(m_ranking, [](auto const& a, auto const& b) {
+        return a.key > b.key;
+    });
+
+    this->trim(getCapacity());
+    this->reindex(0);
+}
+
+size_t UsageStats::getCapacity() {
+    auto limit = geode::Mod::get()->getSettingValue<int64_t>("frequently-used-emojis-limit");
+    return std::max<size_t>(std::max<int64_t>(limit, 0) * CapacityFactor, MinCapacity);
+}
+
+void UsageStats::trim(size_t capacity) {
+    while (m_ranking.size() > capacity) {
+        m_index.erase(m_ranking.back().emoji);
+        m_ranking.pop_back();
+    }
+}
+
+void UsageStats::reindex(size_t from) {
+    for (size_t i = from; i < m_ranking.size(); ++i) {
+        m_index[m_ranking[i].emoji] = i;
+    }
+}
+
+void UsageStats::increment(std::string const& emoji) {
+    m_dirty = true;
+    auto now = static_cast<double>(++m_clock) * DecayRate;
+
+    auto it = m_index.find(emoji);
+    if (it == m_index.end()) {
+        // make room by evicting the lowest score
+        this->trim(getCapacity() - 1);
+        m_ranking.push_back({ emoji, -INFINITY });
+        it = m_index.emplace(emoji, m_ranking.size() - 1).first;
+    }
+
+    // score(now) = exp(key - now), so adding one use gives key = now + log(score(now) + 1)
+    auto pos = it->second;
+    auto& key = m_ranking[pos].key;
+    key = now + std::log1p(std::exp(key - now));
+
+    // keys only grow, so the entry can only move up
+    auto newKey = key;
+    while (pos > 0 && m_ranking[pos - 1].key < newKey) {
+        std::swap(m_ranking[pos - 1], m_ranking[pos]);
+        m_index[m_ranking[pos].emoji] = pos;
+        --pos;
+    }
+    it->second = pos;
+}
+
+std::optional<size_t> UsageStats::getRank(std::string const& emoji) const {
+    if (auto it = m_index.find(emoji); it != m_index.end()) {
+        return it->second;
+    }
+    return std::nullopt;
+}
+
+std::vector<std::string> UsageStats::getTop(size_t count) const {
+    count = std::min(count, m_ranking.size());
+
+    std::vector<std::string> result;
+    result.reserve(count);
+    for (size_t i = 0; i < count; ++i) {
+        result.push_back(m_ranking[i].emoji);
+    }
+    return result;
+}
+
+void UsageStats::flush() {
+    if (!m_dirty) return;
+    m_dirty = false;
+
+    // the limit might have been lowered since the last use
+    this->trim(getCapacity());
+
+    std::map<std::string, double> saved;
+    for (auto& [emoji, key] : m_ranking) {
+        saved.emplace(emoji, key);
+    }
+
+    auto mod = geode::Mod::get();
+    mod->setSavedValue("emoji-usage", saved);
+    mod->setSavedValue("emoji-usage-clock", m_clock);
+    mod->getSaveContainer().erase("frequently-used-emojis");
+}
+
+$on_mod(DataSaved) {
+    UsageStats::get().flush();
+}
@@ -0,0 +1,53 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+/// @brief Resident, bounded table of recently used emojis.
+/// Every use adds 1 to an emoji's score, and all scores halve every `HalfLife` uses,
+/// so the ranking follows what is being used lately rather than lifetime totals.
+/// Only `CapacityFactor` times the "frequently-used-emojis-limit" setting is kept, the lowest scores are evicted.
+/// Loaded from the save container on first use (migrating the old counters), and written back by flush()
+/// when the picker closes or the mod data is saved.
+class UsageStats {
+public:
+    static constexpr double HalfLife = 100.0;   // uses after which a score is halved
+    static constexpr size_t CapacityFactor = 4; // entries kept, per displayed emoji
+    static constexpr size_t MinCapacity = 16;
+
+    static UsageStats& get();
+
+    void increment(std::string const& emoji);
+
+    /// @brief Get the position of an emoji in the ranking (0 is most used).
+    [[nodiscard]] std::optional<size_t> getRank(std::string const& emoji) const;
+
+    /// @brief Get up to `count` most used emojis, most used first.
+    [[nodiscard]] std::vector<std::string> getTop(size_t count) const;
+
+    /// @brief Write the table to the save container, if anything changed.
+    void flush();
+
+protected:
+    UsageStats();
+
+    /// @brief Scores are stored as log(score) + age, so that entries can be compared
+    /// without decaying every one of them on each use.
+    struct Entry {
+        std::string emoji;
+        double key;
+    };
+
+    [[nodiscard]] static size_t getCapacity();
+    void trim(size_t capacity);
+    void reindex(size_t from);
+
+protected:
+    std::vector<Entry> m_ranking;                     // sorted by key (descending)
+    std::unordered_map<std::string, size_t> m_index; // emoji -> position in m_ranking
+    uint64_t m_clock = 0;                            // total uses, drives the decay
+    bool m_dirty = false;                            // changed since the last flush
+};
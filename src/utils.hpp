@@ -1,36 +1,16 @@
 #pragma once
-#include <Geode/binding/TextArea.hpp>
-#include <Geode/binding/MultilineBitmapFont.hpp>
-#include <Geode/loader/Mod.hpp>
-#include "animated-sprite.hpp"
+#include "text.hpp"
 #include <algorithm>
 #include <array>
 #include <cstdint>
+#include <string>
 #include <string_view>
 #include <tuple>
 #include <utility>
+#include <vector>
 
-inline cocos2d::ccColor3B getTextAreaColor(const TextArea* textArea) {
-    auto lines = textArea->m_label->m_lines;
-    if (!lines || lines->count() == 0) {
-        return cocos2d::ccc3(255, 255, 255);
-    }
-
-    auto lineChars = static_cast<cocos2d::CCLabelBMFont*>(lines->objectAtIndex(0))->getChildren();
-    if (!lineChars || lineChars->count() == 0) {
-        return cocos2d::ccc3(255, 255, 255);
-    }
-
-    return static_cast<cocos2d::CCSprite*>(lineChars->objectAtIndex(0))->getColor();
-}
-
-inline void findAndReplace(std::string& str, std::string_view find, std::string_view replace) {
-    size_t pos = 0;
-    while ((pos = str.find(find, pos)) != std::string::npos) {
-        str.replace(pos, find.length(), replace);
-        pos += replace.length();
-    }
-}
+// Compile-time emoji tables. Like text.hpp, this header is kept free of cocos2d and Geode,
+// GEODE_MOD_ID is provided as a compile definition by the build.
 
 template <size_t N>
 struct StringLiteral {
@@ -39,7 +19,19 @@ struct StringLiteral {
     constexpr StringLiteral() = default;
     constexpr StringLiteral(const char (&str)[N]) { std::copy_n(str, N, value); }
     constexpr operator std::string_view() const { return { value, N - 1 }; }
-    constexpr operator geode::geode_internal::StringConcatModIDSlash<N>() const { return value; }
+};
+
+/// @brief Compile-time "<mod id>/<name>" string, same as the ""_spr literal.
+template <size_t N>
+struct ModResourceName {
+    static constexpr size_t modIdSize = sizeof(GEODE_MOD_ID) - 1;
+    char buffer[modIdSize + N + 1]{};
+
+    constexpr ModResourceName(const char (&str)[N]) {
+        std::copy_n(GEODE_MOD_ID, modIdSize, buffer);
+        buffer[modIdSize] = '/';
+        std::copy_n(str, N, buffer + modIdSize + 1);
+    }
 };
 
 template <size_t N>
@@ -147,13 +139,45 @@ struct custom_emoji {
     static constexpr auto sprite = Sprite<C>;
     static constexpr char32_t value = C;
 
-    constexpr operator Label::EmojiMap::value_type() const { return sprite; }
+    constexpr operator EmojiMap::value_type() const { return { sprite.first, { sprite.second, 0 } }; }
     constexpr operator Emoji() const { return emoji; }
 };
 
-template <geode::geode_internal::StringConcatModIDSlash Prefix, size_t FrameCount, size_t FPS>
-cocos2d::CCNode* GetFrameAnimation(std::u32string_view, uint32_t&) {
-    return FrameAnimation::create(Prefix.buffer, FrameCount, 1.f / FPS);
+/// @brief Animated emoji sequence and the frames that should be played for it.
+struct AnimatedEntry {
+    std::u32string_view sequence;
+    const char* prefix = nullptr; // frame name prefix (including mod id)
+    size_t frames = 0;
+    size_t fps = 0;
+    uint16_t width = 0;           // frame size in pixels, filled in by WithFrameSizes
+    uint16_t height = 0;
+};
+
+/// @brief Size of an emoji resource in pixels, by file name (or animation name) without the mod id.
+struct FrameSize {
+    std::string_view name;
+    uint16_t width = 0;
+    uint16_t height = 0;
+};
+
+/// @brief Strip the mod id from a resource name.
+constexpr std::string_view stripModId(std::string_view name) {
+    auto slash = name.find('/');
+    return slash == std::string_view::npos ? name : name.substr(slash + 1);
+}
+
+/// @brief Fill in the frame sizes of every animation. Fails to compile if an animation is missing from the table.
+template <size_t N, size_t M>
+consteval std::array<AnimatedEntry, N> WithFrameSizes(std::array<AnimatedEntry, N> entries, FrameSize const (&sizes)[M]) {
+    for (auto& entry : entries) {
+        auto it = std::find_if(std::begin(sizes), std::end(sizes), [&](FrameSize const& size) {
+            return size.name == stripModId(entry.prefix);
+        });
+        if (it == std::end(sizes)) throw "missing frame size of an animated emoji";
+        entry.width = it->width;
+        entry.height = it->height;
+    }
+    return entries;
 }
 
 template <StringLiteral Name, size_t FrameCount, size_t FPS, char32_t C>
@@ -166,15 +190,12 @@ struct animoji {
         return name;
     }();
     static constexpr auto emoji = CustomEmoji<Name2, C>;
-    static constexpr geode::geode_internal::StringConcatModIDSlash<Name.Size> prefix = Name;
+    static constexpr ModResourceName<Name.Size> prefix = Name.value;
     static constexpr char32_t value = C;
     static constexpr auto name = std::u32string_view(SingleEmoji<C>.value, SingleEmoji<C>.length);
-    static constexpr auto func = &GetFrameAnimation<prefix, FrameCount, FPS>;
 
     constexpr operator Emoji() const { return emoji; }
-    operator Label::CustomNodeMap::value_type() const {
-        return { name, func };
-    }
+    constexpr operator AnimatedEntry() const { return { name, prefix.buffer, FrameCount, FPS }; }
 };
 
 template <StringLiteral Name, StringLiteral Utf8, StringLiteralUTF32 Utf32, size_t FrameCount = 0, size_t FPS = 0, bool Hidden = false>
@@ -221,13 +242,13 @@ struct EmojiCategory {
     std::vector<std::string> emojis;
 };
 
-using EmojiMapEntry = std::pair<std::u32string_view, const char*>;
-using AnimatedEntry = std::pair<std::u32string_view, cocos2d::CCNode*(*)(std::u32string_view, uint32_t&)>;
+using EmojiMapEntry = std::pair<std::u32string_view, EmojiFrame>;
 
-template <StringLiteral Name, StringLiteral Icon, typename... Emojis>
+template <StringLiteral Name, StringLiteral Icon, StringLiteral Sheet, typename... Emojis>
 struct EmojiGroup {
     static constexpr auto GroupName = Name;
     static constexpr auto IconName = Icon;
+    static constexpr auto SheetName = Sheet;
     static constexpr std::tuple<Emojis...> EmojiTuple = { Emojis{}... };
     static constexpr auto TotalSize = sizeof...(Emojis);
     static constexpr auto Size = [] {
@@ -250,20 +271,20 @@ struct EmojiGroup {
         return replacements;
     }
 
-    static consteval std::array<EmojiMapEntry, RegularCount> getRegular() {
+    static consteval std::array<EmojiMapEntry, RegularCount> getRegular(uint8_t page) {
         std::array<EmojiMapEntry, RegularCount> regular;
         size_t index = 0;
-        ((Emojis::isHidden || Emojis::isAnimated ? void() : void(regular[index++] = Emojis::sprite)), ...);
+        ((Emojis::isHidden || Emojis::isAnimated ? void() : void(regular[index++] = {
+            Emojis::sprite.first,
+            { Emojis::sprite.second, page }
+        })), ...);
         return regular;
     }
 
     static consteval std::array<AnimatedEntry, AnimatedCount> getAnimated() {
         std::array<AnimatedEntry, AnimatedCount> animated{};
         size_t index = 0;
-        ((!Emojis::isHidden && Emojis::isAnimated ? void(animated[index++] = {
-            Emojis::animatedSprite.name,
-            Emojis::animatedSprite.func
-        }) : void()), ...);
+        ((!Emojis::isHidden && Emojis::isAnimated ? void(animated[index++] = Emojis::animatedSprite) : void()), ...);
         return animated;
     }
 
@@ -319,7 +340,7 @@ constexpr auto CombineRegulars(auto tuple) {
         if constexpr (Entry::RegularCount == 0) {
             return CombineRegulars<Index + 1, Size>(tuple);
         } else {
-            constexpr auto children = Entry::getRegular();
+            constexpr auto children = Entry::getRegular(Index);
             auto concat = CombineRegulars<Index + 1, Size + children.size()>(tuple);
             std::copy(children.begin(), children.end(), concat.begin() + Size);
             return concat;
@@ -344,6 +365,24 @@ constexpr auto CombineAnimated(auto tuple) {
     }
 }
 
+/// @brief Spritesheet page of an emoji group. Page index matches the group index.
+struct EmojiPage {
+    std::string_view sheet; // spritesheet name (without mod id and extension)
+    const char* probe;      // any frame from the page, used to check if it's loaded
+};
+
+template <typename Tuple>
+constexpr auto CombinePages(Tuple const&) {
+    return []<size_t... I>(std::index_sequence<I...>) {
+        return std::array<EmojiPage, sizeof...(I)>{
+            EmojiPage {
+                std::tuple_element_t<I, Tuple>::SheetName,
+                std::tuple_element_t<I, Tuple>::getRegular(I)[0].second.name
+            }...
+        };
+    }(std::make_index_sequence<std::tuple_size_v<Tuple>>{});
+}
+
 template <size_t Index = 0>
 void PopulateCategoryInfos(auto tuple, std::vector<EmojiCategory>& categories) {
     if constexpr (Index != std::tuple_size_v<decltype(tuple)>) {